@@ -0,0 +1,127 @@
+#include "allocator_bench.h"
+#include "bench_context.h"
+#include "device_allocator.h"
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void printRate(const char* label, size_t count, double seconds) {
+    std::cout << "\t" << label << ": " << count << " in " << seconds * 1000.0 << " ms ("
+              << (seconds > 0.0 ? count / seconds : 0.0) << " /s)" << std::endl;
+}
+
+}
+
+int AllocatorBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+    vk::PhysicalDeviceMemoryProperties memProps = ctx.getPhysicalDevice().getMemoryProperties();
+    uint32_t maxAllocationCount = ctx.getPhysicalDevice().getProperties().limits.maxMemoryAllocationCount;
+
+    uint32_t count = options.count > 0 ? options.count : 10000;
+
+    // 256B〜64KBの頂点バッファを想定した大きさ (実行ごとに同じ列になるよう固定シードで生成する)
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> sizeDist(256, 64 * 1024);
+    std::vector<vk::DeviceSize> sizes(count);
+    for (vk::DeviceSize& size : sizes) {
+        size = sizeDist(rng);
+    }
+
+    auto createBuffers = [&](uint32_t bufferCount) {
+        std::vector<vk::UniqueBuffer> buffers(bufferCount);
+        for (uint32_t i = 0; i < bufferCount; i++) {
+            vk::BufferCreateInfo bufferCreateInfo;
+            bufferCreateInfo.size = sizes[i];
+            bufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+            bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+            buffers[i] = device.createBufferUnique(bufferCreateInfo);
+        }
+        return buffers;
+    };
+
+    // デバイスローカルなメモリタイプを使う
+    vk::MemoryRequirements probeMemReq = device.getBufferMemoryRequirements(createBuffers(1)[0].get());
+    uint32_t memoryTypeIndex = selectMemoryType(memProps, probeMemReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (memoryTypeIndex == UINT32_MAX) {
+        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+        return -1;
+    }
+
+    std::cout << "buffers: " << count << ", maxMemoryAllocationCount: " << maxAllocationCount << std::endl;
+
+    {
+        // バッファごとに allocateMemory() する (maxMemoryAllocationCount を超えないように数を制限する)
+        uint32_t perResourceCount = std::min<uint32_t>(count, maxAllocationCount > 64 ? maxAllocationCount - 64 : 0);
+        std::vector<vk::UniqueBuffer> buffers = createBuffers(perResourceCount);
+        std::vector<vk::UniqueDeviceMemory> memories(perResourceCount);
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < perResourceCount; i++) {
+            vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffers[i].get());
+
+            vk::MemoryAllocateInfo memAllocInfo;
+            memAllocInfo.allocationSize = memReq.size;
+            memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+            memories[i] = device.allocateMemoryUnique(memAllocInfo);
+
+            device.bindBufferMemory(buffers[i].get(), memories[i].get(), 0);
+        }
+        double allocSeconds = elapsedSeconds(start);
+
+        buffers.clear();
+        start = Clock::now();
+        memories.clear();
+        double freeSeconds = elapsedSeconds(start);
+
+        std::cout << "one allocation per buffer";
+        if (perResourceCount < count) {
+            std::cout << " (limited by maxMemoryAllocationCount)";
+        }
+        std::cout << ":" << std::endl;
+        printRate("allocate + bind", perResourceCount, allocSeconds);
+        printRate("free", perResourceCount, freeSeconds);
+    }
+
+    {
+        // DeviceAllocator でブロックから切り出す
+        DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+        std::vector<vk::UniqueBuffer> buffers = createBuffers(count);
+        std::vector<DeviceAllocation> allocations(count);
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            allocations[i] = allocator.allocateForBuffer(buffers[i].get(), memoryTypeIndex, MemoryUsage::GpuOnly);
+        }
+        double allocSeconds = elapsedSeconds(start);
+
+        std::cout << "suballocated:" << std::endl;
+        printRate("allocate + bind", count, allocSeconds);
+        allocator.report(std::cout);
+
+        buffers.clear();
+        start = Clock::now();
+        allocations.clear();
+        double freeSeconds = elapsedSeconds(start);
+
+        printRate("free", count, freeSeconds);
+    }
+
+    return 0;
+}
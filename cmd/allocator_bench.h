@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// バッファごとに allocateMemory() する方法と DeviceAllocator によるサブアロケーションで、
+// 1秒あたりの確保・解放回数を比較するベンチマーク
+class AllocatorBench : public Command {
+public:
+    AllocatorBench(const BenchOptions& options) : options(options) {};
+    ~AllocatorBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
@@ -0,0 +1,67 @@
+#include "bench_context.h"
+#include "frame_scheduler.h"
+
+#include <iostream>
+
+bool BenchContext::init() {
+    // タイムラインセマフォを使うためVulkan 1.2を要求する
+    vk::ApplicationInfo appInfo;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
+
+    vk::InstanceCreateInfo createInfo;
+    createInfo.pApplicationInfo = &appInfo;
+
+    instance = vk::createInstanceUnique(createInfo);
+
+    std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
+
+    bool existsSuitablePhysicalDevice = false;
+    for (size_t i = 0; i < physicalDevices.size(); i++) {
+        if (!FrameScheduler::isSupported(physicalDevices[i])) {
+            continue;
+        }
+
+        std::vector<vk::QueueFamilyProperties> queueProps = physicalDevices[i].getQueueFamilyProperties();
+        for (size_t j = 0; j < queueProps.size(); j++) {
+            if (queueProps[j].queueFlags & vk::QueueFlagBits::eGraphics) {
+                physicalDevice = physicalDevices[i];
+                queueFamilyIndex = j;
+                existsSuitablePhysicalDevice = true;
+                break;
+            }
+        }
+        if (existsSuitablePhysicalDevice) {
+            break;
+        }
+    }
+
+    if (!existsSuitablePhysicalDevice) {
+        std::cerr << "使用可能な物理デバイスがありません。" << std::endl;
+        return false;
+    }
+
+    std::cout << "device: " << physicalDevice.getProperties().deviceName.data() << std::endl;
+
+    vk::DeviceQueueCreateInfo queueCreateInfo[1];
+    queueCreateInfo[0].queueFamilyIndex = queueFamilyIndex;
+    queueCreateInfo[0].queueCount = 1;
+
+    float queuePriorities[1] = {1.0};
+
+    queueCreateInfo[0].pQueuePriorities = queuePriorities;
+
+    vk::DeviceCreateInfo devCreateInfo;
+    devCreateInfo.pQueueCreateInfos = queueCreateInfo;
+    devCreateInfo.queueCreateInfoCount = 1;
+
+    // タイムラインセマフォを有効にする
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    devCreateInfo.pNext = &timelineSemaphoreFeatures;
+
+    device = physicalDevice.createDeviceUnique(devCreateInfo);
+
+    queue = device->getQueue(queueFamilyIndex, 0);
+
+    return true;
+}
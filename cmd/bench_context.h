@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+
+// ベンチマーク用のVulkanデバイス
+//  サーフェースやスワップチェーンを使わず、グラフィックスキュー1本とタイムラインセマフォだけを用意する
+class BenchContext {
+public:
+    BenchContext() = default;
+
+    BenchContext(const BenchContext&) = delete;
+    BenchContext& operator=(const BenchContext&) = delete;
+
+    // インスタンスとデバイスを作成する。使用可能な物理デバイスがない場合はfalseを返す
+    bool init();
+
+    vk::Instance getInstance() const { return instance.get(); }
+    vk::PhysicalDevice getPhysicalDevice() const { return physicalDevice; }
+    vk::Device getDevice() const { return device.get(); }
+    vk::Queue getQueue() const { return queue; }
+    uint32_t getQueueFamilyIndex() const { return queueFamilyIndex; }
+
+private:
+    vk::UniqueInstance instance;
+    vk::PhysicalDevice physicalDevice;
+    vk::UniqueDevice device;
+    vk::Queue queue;
+    uint32_t queueFamilyIndex = 0;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// ベンチマーク (--bench) の実行オプション
+struct BenchOptions {
+    // 処理するリソース数・反復回数 (0ならベンチマークごとの既定値)
+    uint32_t count = 0;
+};
@@ -0,0 +1,410 @@
+#include "buddy_allocator.h"
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BuddyBuffer::~BuddyBuffer() {
+    if (allocator) {
+        allocator->releaseBuffer(this);
+    }
+}
+
+BuddyImage::~BuddyImage() {
+    if (allocator) {
+        allocator->releaseImage(this);
+    }
+}
+
+BuddyAllocator::BuddyAllocator(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t memoryTypeIndex,
+                               vk::DeviceSize blockSize, vk::DeviceSize minAllocationSize)
+    : device(device),
+      memoryTypeIndex(memoryTypeIndex),
+      blockSize(blockSize),
+      minAllocationSize(minAllocationSize),
+      bufferImageGranularity(physicalDevice.getProperties().limits.bufferImageGranularity),
+      scheduler(nullptr),
+      nextBlockId(1),
+      allocationCount(0),
+      requestedBytes(0),
+      allocatedBytes(0),
+      movedBuffers(0),
+      movedBytes(0) {
+}
+
+BuddyAllocator::~BuddyAllocator() {
+    // アロケータより後に破棄されるバッファと画像から解放されないようにする
+    for (BuddyBuffer* buffer : liveBuffers) {
+        buffer->allocator = nullptr;
+    }
+    for (BuddyImage* image : liveImages) {
+        image->allocator = nullptr;
+    }
+}
+
+std::shared_ptr<BuddyBuffer> BuddyAllocator::createBuffer(const vk::BufferCreateInfo& createInfo) {
+    std::shared_ptr<BuddyBuffer> buffer(new BuddyBuffer());
+    buffer->createInfo.flags = createInfo.flags;
+    buffer->createInfo.size = createInfo.size;
+    buffer->createInfo.usage = createInfo.usage | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    buffer->createInfo.sharingMode = createInfo.sharingMode;
+    if (createInfo.sharingMode == vk::SharingMode::eConcurrent) {
+        buffer->queueFamilyIndices.assign(createInfo.pQueueFamilyIndices, createInfo.pQueueFamilyIndices + createInfo.queueFamilyIndexCount);
+        buffer->createInfo.queueFamilyIndexCount = static_cast<uint32_t>(buffer->queueFamilyIndices.size());
+        buffer->createInfo.pQueueFamilyIndices = buffer->queueFamilyIndices.data();
+    }
+    buffer->handle = device.createBufferUnique(buffer->createInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffer->handle.get());
+    if (!(memReq.memoryTypeBits & (1 << memoryTypeIndex))) {
+        throw std::runtime_error("バッファをバディアロケータのメモリタイプに割り当てられません。");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->location = allocateLocked(memReq.size, memReq.alignment);
+    buffer->requestedSize = memReq.size;
+    requestedBytes += memReq.size;
+
+    device.bindBufferMemory(buffer->handle.get(), findBlock(buffer->location.blockId)->memory.get(), buffer->location.offset);
+
+    buffer->allocator = this;
+    liveBuffers.insert(buffer.get());
+    return buffer;
+}
+
+std::shared_ptr<BuddyImage> BuddyAllocator::createImage(const vk::ImageCreateInfo& createInfo) {
+    std::shared_ptr<BuddyImage> image(new BuddyImage());
+    image->handle = device.createImageUnique(createInfo);
+
+    vk::MemoryRequirements memReq = device.getImageMemoryRequirements(image->handle.get());
+    if (!(memReq.memoryTypeBits & (1 << memoryTypeIndex))) {
+        throw std::runtime_error("画像をバディアロケータのメモリタイプに割り当てられません。");
+    }
+
+    // バディの割り当てはサイズに揃った位置から始まるため、粒度以上のサイズで割り当てれば前後のバッファとページを共有しない
+    vk::DeviceSize size = std::max(memReq.size, bufferImageGranularity);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    image->location = allocateLocked(size, memReq.alignment);
+    image->requestedSize = memReq.size;
+    requestedBytes += memReq.size;
+
+    device.bindImageMemory(image->handle.get(), findBlock(image->location.blockId)->memory.get(), image->location.offset);
+
+    image->allocator = this;
+    liveImages.insert(image.get());
+    return image;
+}
+
+uint32_t BuddyAllocator::orderFor(vk::DeviceSize size) const {
+    uint32_t order = 0;
+    while (orderSize(order) < size) {
+        order++;
+    }
+    return order;
+}
+
+BuddyAllocator::Block* BuddyAllocator::findBlock(uint64_t blockId) {
+    for (std::unique_ptr<Block>& block : blocks) {
+        if (block->id == blockId) {
+            return block.get();
+        }
+    }
+    return nullptr;
+}
+
+size_t BuddyAllocator::blockIndex(uint64_t blockId) const {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i]->id == blockId) {
+            return i;
+        }
+    }
+    return blocks.size();
+}
+
+bool BuddyAllocator::isBefore(const BuddyLocation& a, const BuddyLocation& b) const {
+    size_t blockA = blockIndex(a.blockId);
+    size_t blockB = blockIndex(b.blockId);
+    return blockA != blockB ? blockA < blockB : a.offset < b.offset;
+}
+
+bool BuddyAllocator::allocateFromBlock(Block& block, uint32_t order, vk::DeviceSize& offset) {
+    if (order > block.maxOrder) {
+        return false;
+    }
+
+    // 要求以上で最も小さい空き領域を探す
+    uint32_t freeOrder = order;
+    while (freeOrder <= block.maxOrder && block.freeLists[freeOrder].empty()) {
+        freeOrder++;
+    }
+    if (freeOrder > block.maxOrder) {
+        return false;
+    }
+
+    // 前方の領域から使う (デフラグで後方を空けやすくするため)
+    vk::DeviceSize freeOffset = *block.freeLists[freeOrder].begin();
+    block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+
+    // 要求サイズになるまで半分に分割し、後半を空き領域に戻す
+    while (freeOrder > order) {
+        freeOrder--;
+        block.freeLists[freeOrder].insert(freeOffset + orderSize(freeOrder));
+    }
+
+    offset = freeOffset;
+    block.allocationCount++;
+    return true;
+}
+
+BuddyLocation BuddyAllocator::allocateLocked(vk::DeviceSize size, vk::DeviceSize alignment) {
+    // 割り当てはサイズの倍数の位置になるため、アライメントもサイズに含めれば満たされる
+    uint32_t order = orderFor(std::max(size, alignment));
+
+    BuddyLocation location;
+    location.order = order;
+
+    for (std::unique_ptr<Block>& block : blocks) {
+        if (allocateFromBlock(*block, order, location.offset)) {
+            location.blockId = block->id;
+            allocationCount++;
+            allocatedBytes += orderSize(order);
+            return location;
+        }
+    }
+
+    // 空きがなければブロックを追加する (ブロックより大きい要求はそのサイズのブロックにする)
+    auto block = std::make_unique<Block>();
+    block->id = nextBlockId++;
+    block->maxOrder = std::max(orderFor(blockSize), order);
+    block->size = orderSize(block->maxOrder);
+    block->freeLists.resize(block->maxOrder + 1);
+    block->freeLists[block->maxOrder].insert(0);
+
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.allocationSize = block->size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    block->memory = device.allocateMemoryUnique(allocInfo);
+
+    allocateFromBlock(*block, order, location.offset);
+    location.blockId = block->id;
+    blocks.push_back(std::move(block));
+
+    allocationCount++;
+    allocatedBytes += orderSize(order);
+    return location;
+}
+
+void BuddyAllocator::freeLocked(const BuddyLocation& location) {
+    Block* block = findBlock(location.blockId);
+    if (!block) {
+        return;
+    }
+
+    // 隣のバディも空いていれば結合して1つ上のサイズに戻す
+    vk::DeviceSize offset = location.offset;
+    uint32_t order = location.order;
+    while (order < block->maxOrder) {
+        vk::DeviceSize buddy = offset ^ orderSize(order);
+        auto it = block->freeLists[order].find(buddy);
+        if (it == block->freeLists[order].end()) {
+            break;
+        }
+        block->freeLists[order].erase(it);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block->freeLists[order].insert(offset);
+
+    block->allocationCount--;
+    allocationCount--;
+    allocatedBytes -= orderSize(location.order);
+
+    releaseEmptyBlocks();
+}
+
+void BuddyAllocator::releaseEmptyBlocks() {
+    // 空のブロックは先頭の1つを除いて解放する (使用量が減ったらメモリも減るようにする)
+    for (size_t i = blocks.size(); i-- > 1;) {
+        if (blocks[i]->allocationCount == 0) {
+            blocks.erase(blocks.begin() + i);
+        }
+    }
+}
+
+void BuddyAllocator::setScheduler(FrameScheduler* scheduler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->scheduler = scheduler;
+}
+
+void BuddyAllocator::releaseBuffer(BuddyBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    liveBuffers.erase(buffer);
+    requestedBytes -= buffer->requestedSize;
+
+    PendingFree pending;
+    pending.buffer = std::move(buffer->handle);
+    pending.location = buffer->location;
+    releaseLocked(std::move(pending));
+}
+
+void BuddyAllocator::releaseImage(BuddyImage* image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    liveImages.erase(image);
+    requestedBytes -= image->requestedSize;
+
+    PendingFree pending;
+    pending.image = std::move(image->handle);
+    pending.location = image->location;
+    releaseLocked(std::move(pending));
+}
+
+void BuddyAllocator::releaseLocked(PendingFree pending) {
+    if (!scheduler) {
+        pending.buffer.reset();
+        pending.image.reset();
+        freeLocked(pending.location);
+        return;
+    }
+
+    // 投入済みの処理がまだ読み書きしている可能性があるため、それらの完了後に空き領域へ戻す
+    //  (BufferPool::recycleAfter() と同様に、コールバックはスケジューラの retire() で実行される)
+    auto holder = std::make_shared<PendingFree>(std::move(pending));
+    scheduler->onRetire(scheduler->submittedValue(), [this, holder]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        holder->buffer.reset();
+        holder->image.reset();
+        freeLocked(holder->location);
+    });
+}
+
+uint32_t BuddyAllocator::defragment(vk::CommandBuffer cmdBuf, uint32_t maxMoves, vk::DeviceSize maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 後方にあるバッファから順に移動先を探す
+    std::vector<BuddyBuffer*> candidates(liveBuffers.begin(), liveBuffers.end());
+    std::sort(candidates.begin(), candidates.end(), [&](const BuddyBuffer* a, const BuddyBuffer* b) {
+        return isBefore(b->location, a->location);
+    });
+
+    uint32_t moves = 0;
+    vk::DeviceSize bytes = 0;
+    for (BuddyBuffer* candidate : candidates) {
+        if (moves >= maxMoves || bytes + candidate->requestedSize > maxBytes) {
+            break;
+        }
+
+        // 既存のブロックの空き領域のうち、今の位置より前方にあるものにだけ移動する
+        BuddyLocation newLocation;
+        newLocation.order = candidate->location.order;
+        bool found = false;
+        for (std::unique_ptr<Block>& block : blocks) {
+            if (allocateFromBlock(*block, newLocation.order, newLocation.offset)) {
+                newLocation.blockId = block->id;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            continue;
+        }
+        if (!isBefore(newLocation, candidate->location)) {
+            // 前方に空きがないため、仮に取った領域を戻す
+            allocationCount++;
+            allocatedBytes += orderSize(newLocation.order);
+            freeLocked(newLocation);
+            continue;
+        }
+        allocationCount++;
+        allocatedBytes += orderSize(newLocation.order);
+
+        if (moves == 0) {
+            // 先行するフレームでの書き込みが終わってからコピーする
+            vk::MemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {barrier}, {}, {});
+        }
+
+        vk::UniqueBuffer newBuffer = device.createBufferUnique(candidate->createInfo);
+        device.bindBufferMemory(newBuffer.get(), findBlock(newLocation.blockId)->memory.get(), newLocation.offset);
+
+        vk::BufferCopy bufCopy;
+        bufCopy.srcOffset = 0;
+        bufCopy.dstOffset = 0;
+        bufCopy.size = candidate->createInfo.size;
+        cmdBuf.copyBuffer(candidate->handle.get(), newBuffer.get(), {bufCopy});
+
+        // 移動元はコピーが終わるまで残し、commitMoves() で解放を予約する
+        PendingFree pending;
+        pending.buffer = std::move(candidate->handle);
+        pending.location = candidate->location;
+        pendingFrees.push_back(std::move(pending));
+
+        candidate->handle = std::move(newBuffer);
+        candidate->location = newLocation;
+
+        moves++;
+        bytes += candidate->requestedSize;
+    }
+
+    if (moves > 0) {
+        // 後続の処理が移動先を読み書きする前にコピーを完了させる
+        vk::MemoryBarrier barrier;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {barrier}, {}, {});
+    }
+
+    movedBuffers += moves;
+    movedBytes += bytes;
+    return moves;
+}
+
+void BuddyAllocator::commitMoves(FrameScheduler& scheduler, uint64_t value) {
+    std::vector<PendingFree> frees;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frees.swap(pendingFrees);
+    }
+
+    for (PendingFree& pending : frees) {
+        auto holder = std::make_shared<PendingFree>(std::move(pending));
+        scheduler.onRetire(value, [this, holder]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            holder->buffer.reset();
+            freeLocked(holder->location);
+        });
+    }
+}
+
+BuddyAllocator::Stats BuddyAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats s;
+    s.blockCount = blocks.size();
+    s.allocationCount = allocationCount;
+    s.requestedBytes = requestedBytes;
+    s.allocatedBytes = allocatedBytes;
+    s.movedBuffers = movedBuffers;
+    s.movedBytes = movedBytes;
+    for (const std::unique_ptr<Block>& block : blocks) {
+        s.blockBytes += block->size;
+        for (uint32_t order = 0; order <= block->maxOrder; order++) {
+            if (!block->freeLists[order].empty()) {
+                s.freeBytes += orderSize(order) * block->freeLists[order].size();
+                s.largestFreeRange = std::max(s.largestFreeRange, orderSize(order));
+            }
+        }
+    }
+    return s;
+}
+
+void BuddyAllocator::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "buddy allocator: " << s.allocationCount << " allocations in " << s.blockCount << " blocks (" << s.blockBytes << " bytes)"
+       << ", free " << s.freeBytes << " bytes (largest " << s.largestFreeRange << ")"
+       << ", external fragmentation " << s.externalFragmentation() * 100.0 << "%"
+       << ", internal fragmentation " << s.internalFragmentation() * 100.0 << "%"
+       << ", moved " << s.movedBuffers << " buffers (" << s.movedBytes << " bytes)" << std::endl;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+class BuddyAllocator;
+class FrameScheduler;
+
+// BuddyAllocator の割り当て位置
+struct BuddyLocation {
+    uint64_t blockId = 0;
+    vk::DeviceSize offset = 0;
+    uint32_t order = 0;        // 割り当てサイズ = 最小サイズ << order
+};
+
+// BuddyAllocator から作成したバッファ
+//  デフラグで別の位置へ移動することがあるため、vk::Buffer はフレームごとに buffer() で取得し直す
+class BuddyBuffer {
+public:
+    ~BuddyBuffer();
+
+    BuddyBuffer(const BuddyBuffer&) = delete;
+    BuddyBuffer& operator=(const BuddyBuffer&) = delete;
+
+    vk::Buffer buffer() const { return handle.get(); }
+    vk::DeviceSize size() const { return requestedSize; }
+
+private:
+    friend class BuddyAllocator;
+    BuddyBuffer() = default;
+
+    BuddyAllocator* allocator = nullptr;
+    vk::UniqueBuffer handle;
+    // 移動先のバッファの作成に使う。呼び出し元の pNext と pQueueFamilyIndices は移動時に無効になっていることがあるため、
+    //  pNext は持たず、キューファミリーのインデックスは queueFamilyIndices に複製して指す
+    vk::BufferCreateInfo createInfo;
+    std::vector<uint32_t> queueFamilyIndices;
+    vk::DeviceSize requestedSize = 0;
+    BuddyLocation location;
+};
+
+// BuddyAllocator から作成した画像 (コピーで移動できないためデフラグの対象外)
+class BuddyImage {
+public:
+    ~BuddyImage();
+
+    BuddyImage(const BuddyImage&) = delete;
+    BuddyImage& operator=(const BuddyImage&) = delete;
+
+    vk::Image image() const { return handle.get(); }
+
+private:
+    friend class BuddyAllocator;
+    BuddyImage() = default;
+
+    BuddyAllocator* allocator = nullptr;
+    vk::UniqueImage handle;
+    vk::DeviceSize requestedSize = 0;
+    BuddyLocation location;
+};
+
+// 長時間動かし続ける用途向けのバディアロケータ
+//  1つのデバイスローカルのメモリタイプについて2のべき乗サイズのブロックを確保し、
+//  割り当てを2のべき乗サイズに切り上げて分割・結合することで、作成と破棄を繰り返しても空き領域が細切れになりにくくする。
+//  それでも残る断片化は defragment() でバッファを前方の空き領域へ copyBuffer() で移動して解消し、空になったブロックを解放する。
+class BuddyAllocator {
+public:
+    // 断片化の状況
+    struct Stats {
+        uint64_t blockCount = 0;
+        vk::DeviceSize blockBytes = 0;        // 確保中のブロックの合計サイズ
+        uint64_t allocationCount = 0;
+        vk::DeviceSize requestedBytes = 0;    // 要求されたサイズの合計
+        vk::DeviceSize allocatedBytes = 0;    // 2のべき乗に切り上げた割り当てサイズの合計
+        vk::DeviceSize freeBytes = 0;
+        vk::DeviceSize largestFreeRange = 0;
+        uint64_t movedBuffers = 0;            // デフラグで移動したバッファの累計
+        vk::DeviceSize movedBytes = 0;
+
+        // 空き領域のうち最大の連続領域に含まれない割合 (0なら断片化なし)
+        double externalFragmentation() const { return freeBytes > 0 ? 1.0 - double(largestFreeRange) / freeBytes : 0.0; }
+        // 切り上げによって無駄になった割合
+        double internalFragmentation() const { return allocatedBytes > 0 ? 1.0 - double(requestedBytes) / allocatedBytes : 0.0; }
+    };
+
+    BuddyAllocator(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t memoryTypeIndex,
+                   vk::DeviceSize blockSize = 64ull * 1024 * 1024, vk::DeviceSize minAllocationSize = 256);
+    ~BuddyAllocator();
+
+    BuddyAllocator(const BuddyAllocator&) = delete;
+    BuddyAllocator& operator=(const BuddyAllocator&) = delete;
+
+    // バッファを作成してメモリを割り当てる。移動に使うため eTransferSrc と eTransferDst を usage に追加する
+    //  移動先も同じ内容で作成するため、createInfo の pNext は使わない (キューファミリーのインデックスは複製して持つ)
+    //  memoryTypeIndex に割り当てられないバッファの場合は std::runtime_error を投げる
+    std::shared_ptr<BuddyBuffer> createBuffer(const vk::BufferCreateInfo& createInfo);
+
+    // 画像を作成してメモリを割り当てる。bufferImageGranularity 以上の単位で割り当ててバッファと同じページに置かない
+    std::shared_ptr<BuddyImage> createImage(const vk::ImageCreateInfo& createInfo);
+
+    // 後方のブロック・オフセットにあるバッファから順に、前方の空き領域へ移動するコピーを cmdBuf に記録する
+    //  1回の呼び出しで移動するのは maxMoves 個・maxBytes バイトまで (アイドルなフレームに少しずつ進めるため)
+    //  cmdBuf の投入後に commitMoves() を呼ぶこと。戻り値は移動したバッファ数
+    uint32_t defragment(vk::CommandBuffer cmdBuf, uint32_t maxMoves, vk::DeviceSize maxBytes);
+
+    // defragment() で置き換えた移動元のバッファとメモリを、コピーを含む投入 (タイムライン値 value) の完了後に解放する
+    //  解放はスケジューラの retire() で行うため、スケジューラはアロケータより先に破棄すること
+    void commitMoves(FrameScheduler& scheduler, uint64_t value);
+
+    // 破棄されたバッファ・画像の領域を、その時点で投入済みの処理が完了してから空き領域に戻す (GPUが使用中の領域を再利用しないため)
+    //  設定しない場合はすぐに戻す。scheduler はバッファ・画像より長く生存させ、アロケータより先に破棄すること
+    void setScheduler(FrameScheduler* scheduler);
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    friend class BuddyBuffer;
+    friend class BuddyImage;
+
+    struct Block {
+        uint64_t id;
+        vk::UniqueDeviceMemory memory;
+        vk::DeviceSize size;
+        uint32_t maxOrder;
+        std::vector<std::set<vk::DeviceSize>> freeLists; // order ごとの空き領域のオフセット
+        uint64_t allocationCount = 0;
+    };
+
+    // 移動元・破棄したリソースの解放待ちの位置
+    struct PendingFree {
+        vk::UniqueBuffer buffer;
+        vk::UniqueImage image;
+        BuddyLocation location;
+    };
+
+    uint32_t orderFor(vk::DeviceSize size) const;
+    vk::DeviceSize orderSize(uint32_t order) const { return minAllocationSize << order; }
+    BuddyLocation allocateLocked(vk::DeviceSize size, vk::DeviceSize alignment);
+    bool allocateFromBlock(Block& block, uint32_t order, vk::DeviceSize& offset);
+    void freeLocked(const BuddyLocation& location);
+    Block* findBlock(uint64_t blockId);
+    size_t blockIndex(uint64_t blockId) const;
+    bool isBefore(const BuddyLocation& a, const BuddyLocation& b) const;
+    void releaseEmptyBlocks();
+
+    void releaseBuffer(BuddyBuffer* buffer);
+    void releaseImage(BuddyImage* image);
+    void releaseLocked(PendingFree pending);
+
+    vk::Device device;
+    uint32_t memoryTypeIndex;
+    vk::DeviceSize blockSize;
+    vk::DeviceSize minAllocationSize;
+    vk::DeviceSize bufferImageGranularity;
+    FrameScheduler* scheduler;
+
+    mutable std::mutex mutex;
+    uint64_t nextBlockId;
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::set<BuddyBuffer*> liveBuffers;
+    std::set<BuddyImage*> liveImages;
+    std::vector<PendingFree> pendingFrees;
+
+    uint64_t allocationCount;
+    vk::DeviceSize requestedBytes;
+    vk::DeviceSize allocatedBytes;
+    uint64_t movedBuffers;
+    vk::DeviceSize movedBytes;
+};
@@ -0,0 +1,128 @@
+#include "buddy_soak_bench.h"
+#include "bench_context.h"
+#include "buddy_allocator.h"
+#include "frame_scheduler.h"
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+int BuddySoakBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+
+    // 作成・破棄の操作回数と、同時に存在するバッファ数の目安
+    uint32_t operationCount = options.count > 0 ? options.count : 200000;
+    const size_t targetLiveBuffers = 2000;
+    // 何回の操作ごとにアイドルなフレームとしてデフラグを進めるか
+    const uint32_t defragInterval = 100;
+
+    auto makeCreateInfo = [](vk::DeviceSize size) {
+        vk::BufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer;
+        bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+        return bufferCreateInfo;
+    };
+
+    vk::UniqueBuffer probeBuf = device.createBufferUnique(makeCreateInfo(256));
+    vk::MemoryRequirements probeMemReq = device.getBufferMemoryRequirements(probeBuf.get());
+    uint32_t memTypeIndex = selectMemoryType(ctx.getPhysicalDevice().getMemoryProperties(), probeMemReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (memTypeIndex == UINT32_MAX) {
+        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+        return -1;
+    }
+
+    // 移動元の解放をスケジューラの retire() で行うため、アロケータを先に作成する (破棄はスケジューラが先)
+    BuddyAllocator allocator(ctx.getPhysicalDevice(), device, memTypeIndex);
+    FrameScheduler scheduler(device);
+    // 破棄したバッファの領域は、移動のコピーが終わってから再利用する
+    allocator.setScheduler(&scheduler);
+
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.queueFamilyIndex = ctx.getQueueFamilyIndex();
+    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    vk::UniqueCommandPool cmdPool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+
+    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+    cmdBufAllocInfo.commandPool = cmdPool.get();
+    cmdBufAllocInfo.commandBufferCount = 1;
+    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+
+    // 256B〜1MBの対数一様分布 (小さいバッファが多く、大きいバッファが時々混ざる)
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> logSizeDist(std::log2(256.0), std::log2(1024.0 * 1024.0));
+    std::uniform_int_distribution<int> coin(0, 1);
+
+    std::vector<std::shared_ptr<BuddyBuffer>> liveBuffers;
+    vk::DeviceSize minBlockBytes = UINT64_MAX;
+    vk::DeviceSize maxBlockBytes = 0;
+
+    std::cout << "operations: " << operationCount << ", target live buffers: " << targetLiveBuffers << std::endl;
+
+    for (uint32_t op = 1; op <= operationCount; op++) {
+        bool create = liveBuffers.empty() || (liveBuffers.size() < targetLiveBuffers * 2 && (liveBuffers.size() < targetLiveBuffers || coin(rng)));
+        if (create) {
+            vk::DeviceSize size = static_cast<vk::DeviceSize>(std::exp2(logSizeDist(rng)));
+            liveBuffers.push_back(allocator.createBuffer(makeCreateInfo(size)));
+        } else {
+            std::uniform_int_distribution<size_t> indexDist(0, liveBuffers.size() - 1);
+            size_t index = indexDist(rng);
+            std::swap(liveBuffers[index], liveBuffers.back());
+            liveBuffers.pop_back();
+        }
+
+        if (op % defragInterval == 0) {
+            // アイドルなフレーム: 少数のバッファだけを前方へ移動する
+            cmdBufs[0]->reset();
+            vk::CommandBufferBeginInfo cmdBeginInfo;
+            cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            cmdBufs[0]->begin(cmdBeginInfo);
+            uint32_t moves = allocator.defragment(cmdBufs[0].get(), 16, 8 * 1024 * 1024);
+            cmdBufs[0]->end();
+
+            if (moves > 0) {
+                vk::CommandBuffer submitCmdBuf[1] = {cmdBufs[0].get()};
+                vk::SubmitInfo submitInfo;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = submitCmdBuf;
+
+                uint64_t value = scheduler.submit(ctx.getQueue(), submitInfo);
+                allocator.commitMoves(scheduler, value);
+                // 次のフレームでコマンドバッファを再利用するため完了を待つ
+                scheduler.wait(value);
+            }
+            scheduler.retire();
+        }
+
+        BuddyAllocator::Stats stats = allocator.stats();
+        if (op > operationCount / 2) {
+            // 後半の使用量の幅が小さければ、使用量は横ばいになっている
+            minBlockBytes = std::min(minBlockBytes, stats.blockBytes);
+            maxBlockBytes = std::max(maxBlockBytes, stats.blockBytes);
+        }
+
+        if (op % (operationCount / 20 > 0 ? operationCount / 20 : 1) == 0) {
+            std::cout << "op " << op << ": live " << liveBuffers.size()
+                      << ", blocks " << stats.blockCount << " (" << stats.blockBytes / (1024 * 1024) << " MiB)"
+                      << ", requested " << stats.requestedBytes / (1024 * 1024) << " MiB"
+                      << ", external fragmentation " << stats.externalFragmentation() * 100.0 << "%"
+                      << ", internal fragmentation " << stats.internalFragmentation() * 100.0 << "%" << std::endl;
+        }
+    }
+
+    std::cout << "block memory in second half: " << minBlockBytes / (1024 * 1024) << " - " << maxBlockBytes / (1024 * 1024) << " MiB" << std::endl;
+    allocator.report(std::cout);
+
+    liveBuffers.clear();
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// バッファの作成と破棄をランダムに繰り返し、BuddyAllocator のメモリ使用量と断片化の推移を出力する耐久テスト
+//  一定回数ごとの「アイドルなフレーム」でデフラグを少しずつ進める
+class BuddySoakBench : public Command {
+public:
+    BuddySoakBench(const BenchOptions& options) : options(options) {};
+    ~BuddySoakBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
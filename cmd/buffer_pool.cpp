@@ -0,0 +1,115 @@
+#include "buffer_pool.h"
+#include "frame_scheduler.h"
+
+#include <stdexcept>
+
+BufferPool::BufferPool(DeviceAllocator& allocator, uint32_t maxPooledPerClass)
+    : allocator(allocator),
+      maxPooledPerClass(maxPooledPerClass) {
+}
+
+uint32_t BufferPool::sizeClassOf(vk::DeviceSize size) {
+    // minSizeClass << sizeClass >= size となる最小の sizeClass
+    uint32_t sizeClass = 0;
+    while ((minSizeClass << sizeClass) < size) {
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+PooledBuffer BufferPool::acquire(vk::BufferUsageFlags usage, vk::DeviceSize size, MemoryUsage memoryUsage) {
+    uint32_t sizeClass = sizeClassOf(size);
+    Key key(static_cast<VkBufferUsageFlags>(usage), memoryUsage, sizeClass);
+
+    PooledBuffer pooled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.acquireCount++;
+
+        auto it = freeLists.find(key);
+        if (it != freeLists.end() && !it->second.empty()) {
+            pooled.entry = std::move(it->second.back());
+            it->second.pop_back();
+            counters.reuseCount++;
+            counters.pooledBuffers--;
+            counters.pooledBytes -= pooled.entry->capacity;
+            return pooled;
+        }
+        counters.createCount++;
+    }
+
+    // プールにない場合は新しく作成する (作成はロックの外で行う)
+    vk::Device device = allocator.getDevice();
+
+    auto entry = std::make_unique<PooledBuffer::Entry>();
+    entry->capacity = minSizeClass << sizeClass;
+    entry->usage = usage;
+    entry->memoryUsage = memoryUsage;
+
+    vk::BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.size = entry->capacity;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    entry->buffer = device.createBufferUnique(bufferCreateInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(entry->buffer.get());
+    uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, memoryUsage);
+    if (memTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("バッファプールに使えるメモリタイプが存在しません。");
+    }
+    entry->memory = allocator.allocateForBuffer(entry->buffer.get(), memTypeIndex, memoryUsage);
+
+    pooled.entry = std::move(entry);
+    return pooled;
+}
+
+void BufferPool::recycle(PooledBuffer buffer) {
+    if (buffer.entry) {
+        recycleEntry(std::move(buffer.entry));
+    }
+}
+
+void BufferPool::recycleAfter(FrameScheduler& scheduler, uint64_t value, PooledBuffer buffer) {
+    if (!buffer.entry) {
+        return;
+    }
+    // std::function はコピー可能である必要があるため shared_ptr で包む
+    auto holder = std::make_shared<std::unique_ptr<PooledBuffer::Entry>>(std::move(buffer.entry));
+    scheduler.onRetire(value, [this, holder]() {
+        recycleEntry(std::move(*holder));
+    });
+}
+
+void BufferPool::recycleEntry(std::unique_ptr<PooledBuffer::Entry> entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Key key(static_cast<VkBufferUsageFlags>(entry->usage), entry->memoryUsage, sizeClassOf(entry->capacity));
+    std::vector<std::unique_ptr<PooledBuffer::Entry>>& freeList = freeLists[key];
+    if (freeList.size() >= maxPooledPerClass) {
+        // 上限を超えた分はここで解放する
+        return;
+    }
+    counters.pooledBuffers++;
+    counters.pooledBytes += entry->capacity;
+    freeList.push_back(std::move(entry));
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeLists.clear();
+    counters.pooledBuffers = 0;
+    counters.pooledBytes = 0;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void BufferPool::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "buffer pool: acquired " << s.acquireCount << ", reused " << s.reuseCount
+       << " (" << (s.acquireCount > 0 ? s.reuseCount * 100.0 / s.acquireCount : 0.0) << "%)"
+       << ", created " << s.createCount
+       << ", pooled " << s.pooledBuffers << " buffers / " << s.pooledBytes / 1024 << " KiB" << std::endl;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "device_allocator.h"
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include <vector>
+
+class BufferPool;
+class FrameScheduler;
+
+// BufferPool から借りたバッファ
+//  ムーブのみ可能で、破棄すると (recycle() せずに) バッファとメモリを解放する
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() = default;
+
+    PooledBuffer(PooledBuffer&&) noexcept = default;
+    PooledBuffer& operator=(PooledBuffer&&) noexcept = default;
+
+    explicit operator bool() const { return entry != nullptr; }
+
+    vk::Buffer buffer() const { return entry->buffer.get(); }
+    // サイズクラスに切り上げた容量 (要求したサイズ以上)
+    vk::DeviceSize capacity() const { return entry->capacity; }
+
+    // ホスト可視のメモリの場合はマップ済みのアドレス
+    void* mapped() const { return entry->memory.mapped(); }
+    void flush(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const { entry->memory.flush(offset, size); }
+
+private:
+    friend class BufferPool;
+
+    struct Entry {
+        DeviceAllocation memory;
+        vk::UniqueBuffer buffer;  // メモリより先に破棄する
+        vk::DeviceSize capacity;
+        vk::BufferUsageFlags usage;
+        MemoryUsage memoryUsage;
+    };
+
+    std::unique_ptr<Entry> entry;
+};
+
+// 用途(usageフラグとメモリの使い方)と2のべき乗のサイズクラスごとに、使い終わったバッファとメモリの組を再利用するプール
+//  一時的なステージングバッファをアップロードのたびに作成・破棄する代わりに、
+//  GPUでの使用が終わったバッファを recycleAfter() でプールへ戻し、次の acquire() で貸し出す。
+class BufferPool {
+public:
+    struct Stats {
+        uint64_t acquireCount = 0;   // acquire() の回数
+        uint64_t reuseCount = 0;     // プールから再利用した回数
+        uint64_t createCount = 0;    // 新しく作成したバッファ数
+        uint64_t pooledBuffers = 0;  // プールで待機中のバッファ数
+        vk::DeviceSize pooledBytes = 0;
+    };
+
+    // 最小のサイズクラス (これより小さい要求はこのサイズに切り上げる)
+    static constexpr vk::DeviceSize minSizeClass = 256;
+
+    // サイズクラスごとにプールへ残す最大数 (超えた分は解放する)
+    explicit BufferPool(DeviceAllocator& allocator, uint32_t maxPooledPerClass = 16);
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // size バイト以上の容量を持つバッファを貸し出す。同じ用途・サイズクラスのバッファがプールにあれば再利用する
+    //  メモリタイプが見つからない場合は std::runtime_error を投げる
+    PooledBuffer acquire(vk::BufferUsageFlags usage, vk::DeviceSize size, MemoryUsage memoryUsage = MemoryUsage::Upload);
+
+    // GPUでの使用が終わったバッファをすぐにプールへ戻す
+    void recycle(PooledBuffer buffer);
+
+    // タイムライン値 value の処理の完了後にプールへ戻す
+    //  戻す処理はスケジューラの retire() で行うため、スケジューラはプールより先に破棄すること
+    void recycleAfter(FrameScheduler& scheduler, uint64_t value, PooledBuffer buffer);
+
+    // プールで待機中のバッファをすべて解放する
+    void trim();
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    using Key = std::tuple<VkBufferUsageFlags, MemoryUsage, uint32_t>;
+
+    static uint32_t sizeClassOf(vk::DeviceSize size);
+    void recycleEntry(std::unique_ptr<PooledBuffer::Entry> entry);
+
+    DeviceAllocator& allocator;
+    uint32_t maxPooledPerClass;
+
+    mutable std::mutex mutex;
+    std::map<Key, std::vector<std::unique_ptr<PooledBuffer::Entry>>> freeLists;
+    Stats counters;
+};
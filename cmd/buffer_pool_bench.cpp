@@ -0,0 +1,197 @@
+#include "buffer_pool_bench.h"
+#include "bench_context.h"
+#include "buffer_pool.h"
+#include "device_allocator.h"
+#include "frame_scheduler.h"
+#include "memory_type.h"
+#include "mapped_copy.h"
+
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void printUploadRate(const char* label, size_t count, double seconds) {
+    std::cout << label << ": " << count << " uploads in " << seconds * 1000.0 << " ms ("
+              << (count > 0 ? seconds * 1e6 / count : 0.0) << " us/upload)" << std::endl;
+}
+
+}
+
+int BufferPoolBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+    uint32_t uploadCount = options.count > 0 ? options.count : 10000;
+    // 投入したまま完了を待たないアップロードの最大数 (これを超えたら古いものの完了を待つ)
+    const uint32_t maxInFlight = 16;
+    const vk::DeviceSize destinationSize = 1024 * 1024;
+
+    // 64B〜4KBのアップロード (実行ごとに同じ列になるよう固定シードで生成する)
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> sizeDist(64, 4096);
+    std::vector<vk::DeviceSize> sizes(uploadCount);
+    for (vk::DeviceSize& size : sizes) {
+        size = sizeDist(rng) / 4 * 4;
+    }
+    std::vector<char> source(4096, 0x5a);
+
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+
+    // コピー先のデバイスローカルのバッファ
+    vk::BufferCreateInfo dstBufferCreateInfo;
+    dstBufferCreateInfo.size = destinationSize;
+    dstBufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    dstBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    vk::UniqueBuffer dstBuf = device.createBufferUnique(dstBufferCreateInfo);
+
+    vk::MemoryRequirements dstBufMemReq = device.getBufferMemoryRequirements(dstBuf.get());
+    uint32_t dstBufMemTypeIndex = selectMemoryType(allocator.memoryProperties(), dstBufMemReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (dstBufMemTypeIndex == UINT32_MAX) {
+        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+        return -1;
+    }
+    DeviceAllocation dstBufMemory = allocator.allocateForBuffer(dstBuf.get(), dstBufMemTypeIndex, MemoryUsage::GpuOnly);
+
+    auto recordCopy = [&](vk::CommandBuffer cmdBuf, vk::Buffer stagingBuf, uint32_t index) {
+        vk::CommandBufferBeginInfo cmdBeginInfo;
+        cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        vk::BufferCopy bufCopy;
+        bufCopy.srcOffset = 0;
+        bufCopy.dstOffset = (index * 4096ull) % destinationSize;
+        bufCopy.size = sizes[index];
+
+        cmdBuf.begin(cmdBeginInfo);
+        cmdBuf.copyBuffer(stagingBuf, dstBuf.get(), {bufCopy});
+        cmdBuf.end();
+    };
+
+    auto submit = [&](FrameScheduler& scheduler, vk::CommandBuffer cmdBuf) {
+        vk::CommandBuffer submitCmdBuf[1] = {cmdBuf};
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = submitCmdBuf;
+        return scheduler.submit(ctx.getQueue(), submitInfo);
+    };
+
+    std::cout << "uploads: " << uploadCount << " (64B - 4KB), in flight: " << maxInFlight << std::endl;
+
+    double unpooledSeconds = 0.0;
+    {
+        // サンプルの以前の実装と同じく、アップロードごとにステージングバッファ・メモリ・コマンドプールを作成する
+        FrameScheduler scheduler(device);
+        std::vector<uint64_t> values(uploadCount);
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; i++) {
+            if (i >= maxInFlight) {
+                scheduler.wait(values[i - maxInFlight]);
+                scheduler.retire();
+            }
+
+            vk::BufferCreateInfo stagingBufferCreateInfo;
+            stagingBufferCreateInfo.size = sizes[i];
+            stagingBufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+            stagingBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+            vk::UniqueBuffer stagingBuf = device.createBufferUnique(stagingBufferCreateInfo);
+
+            vk::MemoryRequirements stagingBufMemReq = device.getBufferMemoryRequirements(stagingBuf.get());
+            uint32_t stagingBufMemTypeIndex = selectMemoryType(allocator.memoryProperties(), stagingBufMemReq.memoryTypeBits, MemoryUsage::Upload);
+            if (stagingBufMemTypeIndex == UINT32_MAX) {
+                std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+                return -1;
+            }
+            DeviceAllocation stagingBufMemory = allocator.allocateForBuffer(stagingBuf.get(), stagingBufMemTypeIndex, MemoryUsage::Upload);
+            copyToMapped(stagingBufMemory.mapped(), source.data(), sizes[i]);
+            stagingBufMemory.flush(0, sizes[i]);
+
+            vk::CommandPoolCreateInfo tmpCmdPoolCreateInfo;
+            tmpCmdPoolCreateInfo.queueFamilyIndex = ctx.getQueueFamilyIndex();
+            tmpCmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+            vk::UniqueCommandPool tmpCmdPool = device.createCommandPoolUnique(tmpCmdPoolCreateInfo);
+
+            vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
+            tmpCmdBufAllocInfo.commandPool = tmpCmdPool.get();
+            tmpCmdBufAllocInfo.commandBufferCount = 1;
+            tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+            std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device.allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
+
+            recordCopy(tmpCmdBufs[0].get(), stagingBuf.get(), i);
+            values[i] = submit(scheduler, tmpCmdBufs[0].get());
+
+            // コマンドバッファ、プール、バッファ、メモリの順に破棄する
+            scheduler.destroyAfter(values[i], std::move(tmpCmdBufs));
+            scheduler.destroyAfter(values[i], std::move(tmpCmdPool));
+            scheduler.destroyAfter(values[i], std::move(stagingBuf));
+            scheduler.destroyAfter(values[i], std::move(stagingBufMemory));
+        }
+        scheduler.wait(scheduler.submittedValue());
+        scheduler.retire();
+        unpooledSeconds = elapsedSeconds(start);
+
+        printUploadRate("create per upload", uploadCount, unpooledSeconds);
+    }
+
+    double pooledSeconds = 0.0;
+    {
+        // プールのバッファと、使い回すコマンドバッファでアップロードする
+        BufferPool bufferPool(allocator, maxInFlight);
+        FrameScheduler scheduler(device);
+        std::vector<uint64_t> values(uploadCount);
+
+        vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+        cmdPoolCreateInfo.queueFamilyIndex = ctx.getQueueFamilyIndex();
+        cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient;
+        vk::UniqueCommandPool cmdPool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+
+        vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+        cmdBufAllocInfo.commandPool = cmdPool.get();
+        cmdBufAllocInfo.commandBufferCount = maxInFlight;
+        cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+        std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; i++) {
+            // maxInFlight 個前のアップロードが完了すれば、そのコマンドバッファとステージングバッファを再利用できる
+            if (i >= maxInFlight) {
+                scheduler.wait(values[i - maxInFlight]);
+                scheduler.retire();
+            }
+
+            PooledBuffer stagingBuf = bufferPool.acquire(vk::BufferUsageFlagBits::eTransferSrc, sizes[i]);
+            copyToMapped(stagingBuf.mapped(), source.data(), sizes[i]);
+            stagingBuf.flush(0, sizes[i]);
+
+            vk::CommandBuffer cmdBuf = cmdBufs[i % maxInFlight].get();
+            cmdBuf.reset();
+            recordCopy(cmdBuf, stagingBuf.buffer(), i);
+            values[i] = submit(scheduler, cmdBuf);
+
+            bufferPool.recycleAfter(scheduler, values[i], std::move(stagingBuf));
+        }
+        scheduler.wait(scheduler.submittedValue());
+        scheduler.retire();
+        pooledSeconds = elapsedSeconds(start);
+
+        printUploadRate("buffer pool", uploadCount, pooledSeconds);
+        bufferPool.report(std::cout);
+    }
+
+    if (pooledSeconds > 0.0) {
+        std::cout << "speedup: " << unpooledSeconds / pooledSeconds << "x" << std::endl;
+    }
+    allocator.report(std::cout);
+    return 0;
+}
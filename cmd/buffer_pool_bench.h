@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// 小さなアップロードを繰り返し、ステージングバッファとコマンドプールをアップロードごとに作成・破棄する方法と
+// BufferPool で再利用する方法の所要時間を比較するベンチマーク
+class BufferPoolBench : public Command {
+public:
+    BufferPoolBench(const BenchOptions& options) : options(options) {};
+    ~BufferPoolBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
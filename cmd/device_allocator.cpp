@@ -0,0 +1,434 @@
+#include "device_allocator.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+vk::DeviceSize alignDown(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return value / alignment * alignment;
+}
+
+}
+
+DeviceAllocation::~DeviceAllocation() {
+    reset();
+}
+
+DeviceAllocation::DeviceAllocation(DeviceAllocation&& other) noexcept {
+    *this = std::move(other);
+}
+
+DeviceAllocation& DeviceAllocation::operator=(DeviceAllocation&& other) noexcept {
+    if (this != &other) {
+        reset();
+        allocator = other.allocator;
+        deviceMemory = other.deviceMemory;
+        memoryOffset = other.memoryOffset;
+        allocationSize = other.allocationSize;
+        typeIndex = other.typeIndex;
+        blockId = other.blockId;
+        mappedData = other.mappedData;
+        other.allocator = nullptr;
+    }
+    return *this;
+}
+
+void DeviceAllocation::reset() {
+    if (allocator) {
+        allocator->free(*this);
+        allocator = nullptr;
+    }
+}
+
+void DeviceAllocation::flush(vk::DeviceSize offset, vk::DeviceSize size) const {
+    if (allocator) {
+        allocator->flushOrInvalidate(*this, offset, size, true);
+    }
+}
+
+void DeviceAllocation::invalidate(vk::DeviceSize offset, vk::DeviceSize size) const {
+    if (allocator) {
+        allocator->flushOrInvalidate(*this, offset, size, false);
+    }
+}
+
+DeviceAllocator::DeviceAllocator(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize blockSize)
+    : device(device),
+      memProps(physicalDevice.getMemoryProperties()),
+      deviceLimits(physicalDevice.getProperties().limits),
+      blockSize(blockSize),
+      dedicatedThreshold(blockSize / 2),
+      queryDedicated(false),
+      budget(nullptr),
+      nextBlockId(1) {
+    bufferImageGranularity = deviceLimits.bufferImageGranularity;
+    nonCoherentAtomSize = deviceLimits.nonCoherentAtomSize;
+
+    blocks.resize(memProps.memoryTypeCount);
+}
+
+DeviceAllocator::~DeviceAllocator() = default;
+
+bool DeviceAllocator::isDedicatedAllocationSupported(vk::PhysicalDevice physicalDevice) {
+    // VK_KHR_dedicated_allocation と VK_KHR_get_memory_requirements2 は Vulkan 1.1 で標準化された
+    return physicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_1;
+}
+
+void DeviceAllocator::configureDedicatedAllocation(bool queryDriver, vk::DeviceSize threshold) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queryDedicated = queryDriver;
+    dedicatedThreshold = threshold;
+}
+
+vk::DeviceSize DeviceAllocator::getDedicatedThreshold() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dedicatedThreshold;
+}
+
+DeviceAllocation DeviceAllocator::allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryUsage usage, ResourceKind kind) {
+    vk::DeviceSize threshold;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        threshold = dedicatedThreshold;
+    }
+    return allocateBlockRange(requirements, memoryTypeIndex, usage, kind, requirements.size > threshold, nullptr);
+}
+
+DeviceAllocation DeviceAllocator::allocateBlockRange(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryUsage usage, ResourceKind kind,
+                                                     bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo) {
+    // 粒度が1ならリニアと最適タイリングのリソースを同じブロックに混在させてよい
+    if (bufferImageGranularity <= 1) {
+        kind = ResourceKind::Linear;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 専用に確保するリソースはブロックを共有しないため、要件のまま確保する
+    vk::MemoryRequirements rangeRequirements = dedicated ? requirements : suballocationRequirements(requirements, memoryTypeIndex);
+    vk::DeviceSize offset = 0;
+    Block* block = dedicated ? nullptr : findFreeRange(memoryTypeIndex, rangeRequirements, kind, offset);
+
+    if (!block) {
+        // 専用に確保するリソースはちょうどのサイズで、それ以外はブロックの大きさで確保する
+        vk::DeviceSize newBlockSize = dedicated ? requirements.size : std::max(blockSize, rangeRequirements.size);
+
+        // ヒープの使用量が予算に近い場合は、同じ用途で次に適した別のヒープのメモリタイプへ逃がす
+        //  (デバイスローカルのメモリが足りなければホストのメモリに置く。遅くなるが確保の失敗よりはよい)
+        uint32_t heapIndex = memProps.memoryTypes[memoryTypeIndex].heapIndex;
+        if (budget && !budget->hasRoom(heapIndex, newBlockSize)) {
+            uint32_t fallbackTypeIndex = findFallbackMemoryType(requirements.memoryTypeBits, memoryTypeIndex, usage, newBlockSize);
+            if (fallbackTypeIndex != UINT32_MAX) {
+                std::cerr << "メモリタイプ" << memoryTypeIndex << "のヒープが予算に近いため、メモリタイプ" << fallbackTypeIndex << "に割り当てます。" << std::endl;
+                counters.fallbackAllocations++;
+                memoryTypeIndex = fallbackTypeIndex;
+                rangeRequirements = dedicated ? requirements : suballocationRequirements(requirements, memoryTypeIndex);
+                newBlockSize = dedicated ? requirements.size : std::max(blockSize, rangeRequirements.size);
+                block = dedicated ? nullptr : findFreeRange(memoryTypeIndex, rangeRequirements, kind, offset);
+            }
+        }
+
+        if (!block) {
+            std::vector<std::unique_ptr<Block>>& typeBlocks = blocks[memoryTypeIndex];
+            typeBlocks.push_back(createBlock(memoryTypeIndex, newBlockSize, kind, dedicated, dedicatedInfo));
+            block = typeBlocks.back().get();
+            allocateFromBlock(*block, rangeRequirements, offset);
+        }
+    }
+
+    block->allocationCount++;
+    counters.allocationCount++;
+    counters.allocatedBytes += rangeRequirements.size;
+
+    DeviceAllocation allocation;
+    allocation.allocator = this;
+    allocation.deviceMemory = block->memory.get();
+    allocation.memoryOffset = offset;
+    allocation.allocationSize = rangeRequirements.size;
+    allocation.typeIndex = memoryTypeIndex;
+    allocation.blockId = block->id;
+    allocation.mappedData = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+    return allocation;
+}
+
+vk::MemoryRequirements DeviceAllocator::suballocationRequirements(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex) const {
+    // フラッシュ・無効化は範囲を nonCoherentAtomSize に広げるため、コヒーレントでないメモリでは
+    // 領域の先頭とサイズもその倍数にして、隣の割り当ての書き込みを破棄・公開しないようにする
+    vk::MemoryPropertyFlags flags = memProps.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (!(flags & vk::MemoryPropertyFlagBits::eHostVisible) || (flags & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+        return requirements;
+    }
+
+    vk::MemoryRequirements aligned = requirements;
+    aligned.alignment = std::max(requirements.alignment, nonCoherentAtomSize);
+    aligned.size = alignUp(requirements.size, nonCoherentAtomSize);
+    return aligned;
+}
+
+DeviceAllocator::Block* DeviceAllocator::findFreeRange(uint32_t memoryTypeIndex, const vk::MemoryRequirements& requirements, ResourceKind kind, vk::DeviceSize& offset) {
+    for (std::unique_ptr<Block>& candidate : blocks[memoryTypeIndex]) {
+        if (candidate->kind == kind && !candidate->dedicated && allocateFromBlock(*candidate, requirements, offset)) {
+            return candidate.get();
+        }
+    }
+    return nullptr;
+}
+
+uint32_t DeviceAllocator::findFallbackMemoryType(uint32_t memoryTypeBits, uint32_t memoryTypeIndex, MemoryUsage usage, vk::DeviceSize size) const {
+    // 予算に近いヒープと、確保する余地のないヒープのメモリタイプを除いて選び直す
+    uint32_t heapIndex = memProps.memoryTypes[memoryTypeIndex].heapIndex;
+    uint32_t candidateBits = 0;
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+        uint32_t candidateHeap = memProps.memoryTypes[i].heapIndex;
+        if ((memoryTypeBits & (1 << i)) && candidateHeap != heapIndex && budget->hasRoom(candidateHeap, size)) {
+            candidateBits |= 1 << i;
+        }
+    }
+    return selectFallbackMemoryType(memProps, candidateBits, usage);
+}
+
+DeviceAllocation DeviceAllocator::allocateForBuffer(vk::Buffer buffer, uint32_t memoryTypeIndex, MemoryUsage usage) {
+    bool queryDriver;
+    vk::DeviceSize threshold;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queryDriver = queryDedicated;
+        threshold = dedicatedThreshold;
+    }
+
+    if (!queryDriver) {
+        DeviceAllocation allocation = allocate(device.getBufferMemoryRequirements(buffer), memoryTypeIndex, usage, ResourceKind::Linear);
+        device.bindBufferMemory(buffer, allocation.memory(), allocation.offset());
+        return allocation;
+    }
+
+    // ドライバが専用のメモリを望むかどうかを問い合わせる
+    vk::BufferMemoryRequirementsInfo2 requirementsInfo;
+    requirementsInfo.buffer = buffer;
+    auto requirements2 = device.getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(requirementsInfo);
+    const vk::MemoryRequirements& requirements = requirements2.get<vk::MemoryRequirements2>().memoryRequirements;
+    const vk::MemoryDedicatedRequirements& dedicatedRequirements = requirements2.get<vk::MemoryDedicatedRequirements>();
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation || requirements.size > threshold;
+    vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+    dedicatedInfo.buffer = buffer;
+
+    DeviceAllocation allocation = allocateBlockRange(requirements, memoryTypeIndex, usage, ResourceKind::Linear, dedicated, &dedicatedInfo);
+    device.bindBufferMemory(buffer, allocation.memory(), allocation.offset());
+    return allocation;
+}
+
+DeviceAllocation DeviceAllocator::allocateForImage(vk::Image image, uint32_t memoryTypeIndex, MemoryUsage usage, vk::ImageTiling tiling) {
+    ResourceKind kind = tiling == vk::ImageTiling::eLinear ? ResourceKind::Linear : ResourceKind::Optimal;
+
+    bool queryDriver;
+    vk::DeviceSize threshold;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queryDriver = queryDedicated;
+        threshold = dedicatedThreshold;
+    }
+
+    if (!queryDriver) {
+        DeviceAllocation allocation = allocate(device.getImageMemoryRequirements(image), memoryTypeIndex, usage, kind);
+        device.bindImageMemory(image, allocation.memory(), allocation.offset());
+        return allocation;
+    }
+
+    // 大きなレンダーターゲットなどは、専用のメモリにするとドライバが圧縮やページ配置を最適化できることがある
+    vk::ImageMemoryRequirementsInfo2 requirementsInfo;
+    requirementsInfo.image = image;
+    auto requirements2 = device.getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(requirementsInfo);
+    const vk::MemoryRequirements& requirements = requirements2.get<vk::MemoryRequirements2>().memoryRequirements;
+    const vk::MemoryDedicatedRequirements& dedicatedRequirements = requirements2.get<vk::MemoryDedicatedRequirements>();
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation || requirements.size > threshold;
+    vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+    dedicatedInfo.image = image;
+
+    DeviceAllocation allocation = allocateBlockRange(requirements, memoryTypeIndex, usage, kind, dedicated, &dedicatedInfo);
+    device.bindImageMemory(image, allocation.memory(), allocation.offset());
+    return allocation;
+}
+
+std::unique_ptr<DeviceAllocator::Block> DeviceAllocator::createBlock(uint32_t memoryTypeIndex, vk::DeviceSize size, ResourceKind kind,
+                                                                     bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo) {
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    // 専用のメモリであることをドライバに伝える (閾値を超えただけのリソースでも伝えてよい)
+    if (dedicated && dedicatedInfo) {
+        allocInfo.pNext = dedicatedInfo;
+    }
+
+    auto block = std::make_unique<Block>();
+    block->id = nextBlockId++;
+    block->memory = device.allocateMemoryUnique(allocInfo);
+    block->size = size;
+    block->kind = kind;
+    block->dedicated = dedicated;
+    block->mapped = nullptr;
+    block->freeRanges[0] = size;
+    block->allocationCount = 0;
+
+    // ホストから参照できるブロックは確保時に一度だけマップし、切り出した領域で共有する
+    if (memProps.memoryTypes[memoryTypeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        block->mapped = device.mapMemory(block->memory.get(), 0, VK_WHOLE_SIZE);
+    }
+
+    counters.blockCount++;
+    counters.blockBytes += size;
+    counters.deviceAllocateCalls++;
+    if (dedicated) {
+        counters.dedicatedBlockCount++;
+    }
+    if (budget) {
+        budget->notifyAllocated(memProps.memoryTypes[memoryTypeIndex].heapIndex, size);
+    }
+    return block;
+}
+
+bool DeviceAllocator::allocateFromBlock(Block& block, const vk::MemoryRequirements& requirements, vk::DeviceSize& offset) {
+    vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+    // 先頭から順に、整列後に収まる最初の空き領域を使う
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        vk::DeviceSize rangeOffset = it->first;
+        vk::DeviceSize rangeEnd = it->first + it->second;
+        vk::DeviceSize alignedOffset = alignUp(rangeOffset, alignment);
+        if (alignedOffset + requirements.size > rangeEnd) {
+            continue;
+        }
+
+        block.freeRanges.erase(it);
+        // 整列で空いた前方と、割り当て後の残りを空き領域に戻す
+        if (alignedOffset > rangeOffset) {
+            block.freeRanges[rangeOffset] = alignedOffset - rangeOffset;
+        }
+        if (alignedOffset + requirements.size < rangeEnd) {
+            block.freeRanges[alignedOffset + requirements.size] = rangeEnd - (alignedOffset + requirements.size);
+        }
+
+        offset = alignedOffset;
+        return true;
+    }
+    return false;
+}
+
+void DeviceAllocator::setBudget(MemoryBudget* memoryBudget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = memoryBudget;
+}
+
+void DeviceAllocator::free(const DeviceAllocation& allocation) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<std::unique_ptr<Block>>& typeBlocks = blocks[allocation.typeIndex];
+    auto blockIt = std::find_if(typeBlocks.begin(), typeBlocks.end(), [&](const std::unique_ptr<Block>& block) {
+        return block->id == allocation.blockId;
+    });
+    if (blockIt == typeBlocks.end()) {
+        return;
+    }
+    Block& block = **blockIt;
+
+    // 空き領域に戻し、前後の空き領域と結合する
+    vk::DeviceSize offset = allocation.memoryOffset;
+    vk::DeviceSize size = allocation.allocationSize;
+    auto next = block.freeRanges.lower_bound(offset);
+    if (next != block.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            block.freeRanges.erase(prev);
+        }
+    }
+    block.freeRanges[offset] = size;
+
+    block.allocationCount--;
+    counters.allocationCount--;
+    counters.allocatedBytes -= allocation.allocationSize;
+
+    // 空になったブロックは、同じ種類のブロックが他にもあれば解放する (確保と解放の繰り返しを避けるため最後の1つは残す)
+    if (block.allocationCount == 0) {
+        size_t sameKindBlocks = std::count_if(typeBlocks.begin(), typeBlocks.end(), [&](const std::unique_ptr<Block>& other) {
+            return other->kind == block.kind;
+        });
+        if (block.dedicated || sameKindBlocks > 1 || block.size != blockSize) {
+            counters.blockCount--;
+            if (block.dedicated) {
+                counters.dedicatedBlockCount--;
+            }
+            counters.blockBytes -= block.size;
+            if (budget) {
+                budget->notifyFreed(memProps.memoryTypes[allocation.typeIndex].heapIndex, block.size);
+            }
+            typeBlocks.erase(blockIt);
+        }
+    }
+}
+
+void DeviceAllocator::flushOrInvalidate(const DeviceAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size, bool flush) const {
+    if (memProps.memoryTypes[allocation.typeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent) {
+        return;
+    }
+
+    if (size == VK_WHOLE_SIZE) {
+        size = allocation.allocationSize - offset;
+    }
+
+    // 範囲は nonCoherentAtomSize の倍数に揃える必要がある
+    //  ブロックの末尾を超える場合は VK_WHOLE_SIZE にする
+    vk::DeviceSize begin = alignDown(allocation.memoryOffset + offset, nonCoherentAtomSize);
+    vk::DeviceSize end = alignUp(allocation.memoryOffset + offset + size, nonCoherentAtomSize);
+
+    vk::MappedMemoryRange range;
+    range.memory = allocation.deviceMemory;
+    range.offset = begin;
+    range.size = end - begin;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<Block>& block : blocks[allocation.typeIndex]) {
+            if (block->id == allocation.blockId && end > block->size) {
+                range.size = VK_WHOLE_SIZE;
+            }
+        }
+    }
+
+    if (flush) {
+        device.flushMappedMemoryRanges({range});
+    } else {
+        device.invalidateMappedMemoryRanges({range});
+    }
+}
+
+DeviceAllocator::Stats DeviceAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void DeviceAllocator::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "device allocator: " << s.allocationCount << " allocations (" << s.allocatedBytes << " bytes)"
+       << " in " << s.blockCount << " blocks (" << s.blockBytes << " bytes)"
+       << ", allocateMemory calls: " << s.deviceAllocateCalls;
+    if (s.dedicatedBlockCount > 0) {
+        os << ", dedicated: " << s.dedicatedBlockCount;
+    }
+    if (s.fallbackAllocations > 0) {
+        os << ", fallbacks over budget: " << s.fallbackAllocations;
+    }
+    os << std::endl;
+}
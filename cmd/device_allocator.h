@@ -0,0 +1,151 @@
+#pragma once
+
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+class DeviceAllocator;
+class MemoryBudget;
+
+// DeviceAllocator から確保したメモリ領域
+//  UniqueHandle と同様にムーブのみ可能で、破棄時に領域をアロケータへ返す
+class DeviceAllocation {
+public:
+    DeviceAllocation() = default;
+    ~DeviceAllocation();
+
+    DeviceAllocation(DeviceAllocation&& other) noexcept;
+    DeviceAllocation& operator=(DeviceAllocation&& other) noexcept;
+
+    DeviceAllocation(const DeviceAllocation&) = delete;
+    DeviceAllocation& operator=(const DeviceAllocation&) = delete;
+
+    explicit operator bool() const { return allocator != nullptr; }
+
+    vk::DeviceMemory memory() const { return deviceMemory; }
+    vk::DeviceSize offset() const { return memoryOffset; }
+    vk::DeviceSize size() const { return allocationSize; }
+    uint32_t memoryTypeIndex() const { return typeIndex; }
+
+    // ホストから参照できるメモリタイプの場合はマップ済みのアドレス (それ以外はnullptr)
+    void* mapped() const { return mappedData; }
+
+    // ホストでの書き込みをデバイスから見えるようにする (HostCoherentの場合は何もしない)
+    void flush(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const;
+    // デバイスでの書き込みをホストから見えるようにする (HostCoherentの場合は何もしない)
+    void invalidate(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const;
+
+    void reset();
+
+private:
+    friend class DeviceAllocator;
+
+    DeviceAllocator* allocator = nullptr;
+    vk::DeviceMemory deviceMemory;
+    vk::DeviceSize memoryOffset = 0;
+    vk::DeviceSize allocationSize = 0;
+    uint32_t typeIndex = 0;
+    uint64_t blockId = 0;
+    void* mappedData = nullptr;
+};
+
+// 大きなブロック単位でデバイスメモリを確保し、バッファや画像へ切り出して割り当てるアロケータ
+//  リソースごとに allocateMemory() するとドライバ呼び出しのコストがかかる上、
+//  maxMemoryAllocationCount (多くの環境で4096) の上限にすぐ達するため、ブロックをメモリタイプごとに共有する。
+//  リニアなリソース(バッファ、リニア画像)と最適タイリングの画像が bufferImageGranularity 内で隣接しないように、
+//  粒度が1より大きい場合は両者を別のブロックに割り当てる。
+class DeviceAllocator {
+public:
+    // リソースの種類 (bufferImageGranularity の判定に使う)
+    enum class ResourceKind { Linear, Optimal };
+
+    struct Stats {
+        uint64_t blockCount = 0;          // 確保中のブロック数 (= vk::DeviceMemory の数)
+        uint64_t blockBytes = 0;          // ブロックの合計サイズ
+        uint64_t allocationCount = 0;     // 割り当て中の領域数
+        uint64_t allocatedBytes = 0;      // 割り当て中の領域の合計サイズ
+        uint64_t deviceAllocateCalls = 0; // これまでの allocateMemory() 呼び出し回数
+        uint64_t dedicatedBlockCount = 0; // 1つのリソース専用に確保中のブロック数
+        uint64_t fallbackAllocations = 0; // 予算を超えそうなため別のヒープに割り当てた回数
+    };
+
+    DeviceAllocator(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize blockSize = 64ull * 1024 * 1024);
+    ~DeviceAllocator();
+
+    DeviceAllocator(const DeviceAllocator&) = delete;
+    DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+    // メモリ要件を満たす領域を memoryTypeIndex のブロックから割り当てる
+    //  usage は memoryTypeIndex を選んだ時の用途で、予算のため別のヒープへ逃がす時のメモリタイプの選択に使う
+    DeviceAllocation allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryUsage usage, ResourceKind kind);
+
+    // バッファ・画像用の領域を割り当て、メモリを紐づける
+    DeviceAllocation allocateForBuffer(vk::Buffer buffer, uint32_t memoryTypeIndex, MemoryUsage usage);
+    DeviceAllocation allocateForImage(vk::Image image, uint32_t memoryTypeIndex, MemoryUsage usage, vk::ImageTiling tiling);
+
+    // 専用割り当て (VK_KHR_dedicated_allocation。Vulkan 1.1 で標準化) に対応しているか
+    static bool isDedicatedAllocationSupported(vk::PhysicalDevice physicalDevice);
+
+    // threshold バイトを超えるリソースは、ブロックから切り出さずにそのリソース専用のメモリを確保する (既定値はブロックサイズの半分)
+    //  queryDriver が true なら allocateForBuffer()/allocateForImage() でドライバが専用のメモリを望むかも問い合わせ、
+    //  望む場合は閾値未満でも専用に確保する。Vulkan 1.1 以上のインスタンスとデバイスでのみ true にすること
+    void configureDedicatedAllocation(bool queryDriver, vk::DeviceSize threshold);
+    vk::DeviceSize getDedicatedThreshold() const;
+
+    // ブロックの確保・解放を budget に通知し、ヒープの使用量が予算に近い場合は別のヒープのメモリタイプに割り当てる
+    //  budget はアロケータより長く生存させること
+    void setBudget(MemoryBudget* budget);
+
+    vk::Device getDevice() const { return device; }
+    const vk::PhysicalDeviceMemoryProperties& memoryProperties() const { return memProps; }
+    const vk::PhysicalDeviceLimits& limits() const { return deviceLimits; }
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    friend class DeviceAllocation;
+
+    struct Block {
+        uint64_t id;
+        vk::UniqueDeviceMemory memory;
+        vk::DeviceSize size;
+        ResourceKind kind;
+        bool dedicated;  // 1つのリソース専用 (他のリソースを割り当てない)
+        void* mapped;
+        std::map<vk::DeviceSize, vk::DeviceSize> freeRanges; // 空き領域 (オフセット → サイズ)
+        uint32_t allocationCount;
+    };
+
+    vk::MemoryRequirements suballocationRequirements(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex) const;
+    Block* findFreeRange(uint32_t memoryTypeIndex, const vk::MemoryRequirements& requirements, ResourceKind kind, vk::DeviceSize& offset);
+    uint32_t findFallbackMemoryType(uint32_t memoryTypeBits, uint32_t memoryTypeIndex, MemoryUsage usage, vk::DeviceSize size) const;
+    DeviceAllocation allocateBlockRange(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryUsage usage, ResourceKind kind,
+                                        bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo);
+    std::unique_ptr<Block> createBlock(uint32_t memoryTypeIndex, vk::DeviceSize size, ResourceKind kind,
+                                       bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo);
+    static bool allocateFromBlock(Block& block, const vk::MemoryRequirements& requirements, vk::DeviceSize& offset);
+    void free(const DeviceAllocation& allocation);
+    void flushOrInvalidate(const DeviceAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size, bool flush) const;
+
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties memProps;
+    vk::PhysicalDeviceLimits deviceLimits;
+    vk::DeviceSize bufferImageGranularity;
+    vk::DeviceSize nonCoherentAtomSize;
+    vk::DeviceSize blockSize;
+    vk::DeviceSize dedicatedThreshold;
+    bool queryDedicated;
+    MemoryBudget* budget;
+
+    mutable std::mutex mutex;
+    uint64_t nextBlockId;
+    std::vector<std::vector<std::unique_ptr<Block>>> blocks; // メモリタイプごと
+    Stats counters;
+};
@@ -0,0 +1,159 @@
+#include "fill_worker_pool.h"
+#include "mapped_copy.h"
+
+#include <algorithm>
+
+FillWorkerPool::Region FillWorkerPool::copyRegion(vk::DeviceSize stagingOffset, const void* data, vk::DeviceSize size) {
+    Region region;
+    region.stagingOffset = stagingOffset;
+    region.size = size;
+    region.fill = [data](void* dst, vk::DeviceSize begin, vk::DeviceSize end) {
+        copyToMapped(dst, static_cast<const char*>(data) + begin, end - begin);
+    };
+    return region;
+}
+
+FillWorkerPool::FillWorkerPool(uint32_t threadCount, vk::DeviceSize chunkSize)
+    : chunkSize(std::max<vk::DeviceSize>(chunkSize, 1)),
+      generation(0),
+      pendingWorkers(0),
+      stopping(false),
+      jobStaging(nullptr),
+      jobRegions(nullptr),
+      nextChunk(0) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // 呼び出し元のスレッドも書き込むため、ワーカーは1つ少なく作る
+    for (uint32_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&FillWorkerPool::run, this);
+    }
+}
+
+FillWorkerPool::~FillWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void FillWorkerPool::fill(const PooledBuffer& staging, const std::vector<Region>& regions) {
+    // 小さな領域は chunkSize に達するまで1つのチャンクにまとめ (フラッシュの回数を減らす)、
+    // 大きな領域は要素の境界で chunkSize ごとに分ける
+    pieces.clear();
+    chunks.clear();
+    for (uint32_t i = 0; i < regions.size(); i++) {
+        const Region& region = regions[i];
+        vk::DeviceSize elementSize = std::max<vk::DeviceSize>(region.elementSize, 1);
+        vk::DeviceSize step = std::max(chunkSize / elementSize, vk::DeviceSize(1)) * elementSize;
+        for (vk::DeviceSize begin = 0; begin < region.size;) {
+            if (chunks.empty() || chunks.back().flushEnd - chunks.back().flushBegin >= chunkSize) {
+                Chunk chunk;
+                chunk.firstPiece = static_cast<uint32_t>(pieces.size());
+                chunk.pieceCount = 0;
+                chunk.flushBegin = region.stagingOffset + begin;
+                chunk.flushEnd = chunk.flushBegin;
+                chunks.push_back(chunk);
+            }
+            Chunk& chunk = chunks.back();
+            vk::DeviceSize end = std::min(region.size, begin + step);
+
+            Piece piece;
+            piece.regionIndex = i;
+            piece.begin = begin;
+            piece.end = end;
+            pieces.push_back(piece);
+            chunk.pieceCount++;
+            chunk.flushEnd = region.stagingOffset + end;
+            begin = end;
+        }
+    }
+    if (chunks.empty()) {
+        return;
+    }
+
+    // チャンクが1つならワーカーを起こさない
+    bool useWorkers = chunks.size() > 1 && !workers.empty();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobStaging = &staging;
+        jobRegions = &regions;
+        jobError = nullptr;
+        nextChunk = 0;
+        pendingWorkers = useWorkers ? static_cast<uint32_t>(workers.size()) : 0;
+        if (useWorkers) {
+            generation++;
+        }
+    }
+    if (useWorkers) {
+        startCondition.notify_all();
+    }
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [&]() { return pendingWorkers == 0; });
+
+    jobStaging = nullptr;
+    jobRegions = nullptr;
+    if (jobError) {
+        std::rethrow_exception(jobError);
+    }
+}
+
+void FillWorkerPool::runChunks() {
+    char* stagingData = static_cast<char*>(jobStaging->mapped());
+    while (true) {
+        uint32_t chunkIndex = nextChunk.fetch_add(1);
+        if (chunkIndex >= chunks.size()) {
+            return;
+        }
+        const Chunk& chunk = chunks[chunkIndex];
+
+        try {
+            for (uint32_t i = 0; i < chunk.pieceCount; i++) {
+                const Piece& piece = pieces[chunk.firstPiece + i];
+                const Region& region = (*jobRegions)[piece.regionIndex];
+                region.fill(stagingData + region.stagingOffset + piece.begin, piece.begin, piece.end);
+            }
+            // 書き込んだチャンクだけをフラッシュする (HostCoherentの場合は何もしない)
+            jobStaging->flush(chunk.flushBegin, chunk.flushEnd - chunk.flushBegin);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!jobError) {
+                jobError = std::current_exception();
+            }
+        }
+    }
+}
+
+void FillWorkerPool::run() {
+    uint64_t handledGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&]() { return stopping || generation != handledGeneration; });
+            if (stopping) {
+                return;
+            }
+            handledGeneration = generation;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingWorkers--;
+            if (pendingWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "buffer_pool.h"
+
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// マップしたステージングバッファへの書き込み(コピー、頂点データの変換・量子化など)を複数スレッドで分担するワーカープール
+//  書き込む範囲をチャンクに分けてワーカーと呼び出し元のスレッドで並列に書き込み、書き込んだチャンクごとにフラッシュする。
+class FillWorkerPool {
+public:
+    // 領域の begin〜end バイト目を dst に書き込む処理 (dst は begin バイト目の書き込み先)
+    //  異なるチャンクについて複数のスレッドから同時に呼ばれる
+    using FillFunc = std::function<void(void* dst, vk::DeviceSize begin, vk::DeviceSize end)>;
+
+    // ステージングバッファ内の書き込み先の領域
+    struct Region {
+        vk::DeviceSize stagingOffset = 0;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize elementSize = 1;  // チャンクの境界をこの倍数にする (変換する要素の途中で分けない)
+        FillFunc fill;
+    };
+
+    // data から size バイトをコピーする領域
+    static Region copyRegion(vk::DeviceSize stagingOffset, const void* data, vk::DeviceSize size);
+
+    // threadCount は呼び出し元を含むスレッド数 (0ならハードウェアのスレッド数)
+    //  chunkSize より小さい領域は1つのチャンクにまとめ、大きい領域は chunkSize ごとに分ける
+    explicit FillWorkerPool(uint32_t threadCount = 0, vk::DeviceSize chunkSize = 256 * 1024);
+    ~FillWorkerPool();
+
+    FillWorkerPool(const FillWorkerPool&) = delete;
+    FillWorkerPool& operator=(const FillWorkerPool&) = delete;
+
+    uint32_t size() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // staging の各領域をチャンクに分けて並列に書き込み、チャンクごとにフラッシュする。全チャンクの完了まで戻らない
+    //  領域は stagingOffset の昇順に並べること。書き込み処理が投げた例外は呼び出し元へ投げ直す
+    void fill(const PooledBuffer& staging, const std::vector<Region>& regions);
+
+private:
+    // 領域の一部 (1つのチャンクは連続した複数の部分からなる)
+    struct Piece {
+        uint32_t regionIndex;
+        vk::DeviceSize begin;
+        vk::DeviceSize end;
+    };
+
+    struct Chunk {
+        uint32_t firstPiece;
+        uint32_t pieceCount;
+        vk::DeviceSize flushBegin;  // フラッシュするステージングバッファ内の範囲
+        vk::DeviceSize flushEnd;
+    };
+
+    void run();
+    void runChunks();
+
+    vk::DeviceSize chunkSize;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation;
+    uint32_t pendingWorkers;
+    bool stopping;
+
+    // 実行中のジョブ (fill() の呼び出し中のみ有効)
+    const PooledBuffer* jobStaging;
+    const std::vector<Region>* jobRegions;
+    std::vector<Piece> pieces;
+    std::vector<Chunk> chunks;
+    std::atomic<uint32_t> nextChunk;
+    std::exception_ptr jobError;
+};
@@ -0,0 +1,78 @@
+#include "frame_counter.h"
+
+#include <algorithm>
+#include <cmath>
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+
+    // 最近傍順位法で求める
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    size_t index = std::min(std::max<size_t>(rank, 1), samples.size()) - 1;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+FrameCounter::FrameCounter() : frames(0), start(Clock::now()), lastTick(start), acquireTime(start), recordStartTime(start) {}
+
+void FrameCounter::markAcquire() {
+    acquireTime = Clock::now();
+}
+
+void FrameCounter::markRecordStart() {
+    recordStartTime = Clock::now();
+}
+
+void FrameCounter::markSubmitted() {
+    if (recordSubmitMs.size() < maxSamples) {
+        recordSubmitMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - recordStartTime).count());
+    }
+}
+
+void FrameCounter::tick() {
+    Clock::time_point now = Clock::now();
+
+    if (frameTimesMs.size() < maxSamples) {
+        frameTimesMs.push_back(std::chrono::duration<double, std::milli>(now - lastTick).count());
+        acquireToPresentMs.push_back(std::chrono::duration<double, std::milli>(now - acquireTime).count());
+    }
+
+    lastTick = now;
+    frames++;
+}
+
+void FrameCounter::report(std::ostream& os) const {
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    double fps = elapsed.count() > 0.0 ? frames / elapsed.count() : 0.0;
+    double msPerFrame = frames > 0 ? elapsed.count() * 1000.0 / frames : 0.0;
+
+    os << "frames: " << frames
+       << ", elapsed: " << elapsed.count() << " s"
+       << ", throughput: " << fps << " fps"
+       << " (" << msPerFrame << " ms/frame)" << std::endl;
+
+    os << "frame time [ms]: p50 " << percentile(frameTimesMs, 50)
+       << ", p95 " << percentile(frameTimesMs, 95)
+       << ", p99 " << percentile(frameTimesMs, 99)
+       << ", max " << percentile(frameTimesMs, 100) << std::endl;
+
+    // 中央値の2倍を超えたフレームをスパイクとして数える
+    double spikeThresholdMs = percentile(frameTimesMs, 50) * 2.0;
+    size_t spikes = std::count_if(frameTimesMs.begin(), frameTimesMs.end(), [&](double ms) { return ms > spikeThresholdMs; });
+    os << "frame time spikes (> " << spikeThresholdMs << " ms): " << spikes << std::endl;
+
+    os << "acquire to present [ms]: p50 " << percentile(acquireToPresentMs, 50)
+       << ", p95 " << percentile(acquireToPresentMs, 95)
+       << ", p99 " << percentile(acquireToPresentMs, 99)
+       << ", max " << percentile(acquireToPresentMs, 100) << std::endl;
+
+    if (!recordSubmitMs.empty()) {
+        os << "record + submit (CPU) [ms]: p50 " << percentile(recordSubmitMs, 50)
+           << ", p95 " << percentile(recordSubmitMs, 95)
+           << ", p99 " << percentile(recordSubmitMs, 99)
+           << ", max " << percentile(recordSubmitMs, 100) << std::endl;
+    }
+}
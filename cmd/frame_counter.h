@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// サンプル列の百分位数 (p: 0〜100) を求める。空の場合は0を返す
+double percentile(std::vector<double> samples, double p);
+
+// レンダーループのスループット(フレーム数/秒)とフレーム時間を計測する
+class FrameCounter {
+public:
+    FrameCounter();
+
+    // acquireNextImageKHR() を呼ぶ直前に呼ぶ
+    void markAcquire();
+
+    // コマンドの記録を始める直前に呼ぶ
+    void markRecordStart();
+
+    // キューへの投入が終わった直後に呼ぶ (記録開始からここまでをCPU時間として集計する)
+    void markSubmitted();
+
+    // presentKHR() の後、1フレーム分の処理が終わるたびに呼ぶ
+    void tick();
+
+    uint64_t count() const { return frames; }
+
+    // フレーム数、平均フレームレート、フレーム時間と取得〜表示間のレイテンシの分布を出力する
+    void report(std::ostream& os) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 長時間の実行でもメモリが増え続けないように保持するサンプル数の上限
+    static constexpr size_t maxSamples = 1 << 20;
+
+    uint64_t frames;
+    Clock::time_point start;
+    Clock::time_point lastTick;
+    Clock::time_point acquireTime;
+    Clock::time_point recordStartTime;
+    std::vector<double> frameTimesMs;
+    std::vector<double> acquireToPresentMs;
+    std::vector<double> recordSubmitMs;
+};
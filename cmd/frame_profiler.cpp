@@ -0,0 +1,66 @@
+#include "frame_profiler.h"
+#include "frame_counter.h"
+
+#include <algorithm>
+#include <vector>
+
+FrameProfiler::FrameProfiler(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1)),
+      samples(new std::atomic<uint64_t>[std::max<size_t>(capacity, 1)]),
+      writeIndex(0) {
+    for (size_t i = 0; i < this->capacity; i++) {
+        samples[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void FrameProfiler::begin(FrameStage stage) {
+    stageStart[static_cast<size_t>(stage)] = Clock::now();
+}
+
+void FrameProfiler::end(FrameStage stage) {
+    auto duration = Clock::now() - stageStart[static_cast<size_t>(stage)];
+    record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+void FrameProfiler::record(FrameStage stage, uint64_t durationNs) {
+    uint64_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+    uint64_t packed = (static_cast<uint64_t>(stage) << stageShift) | (durationNs & durationMask);
+    samples[index % capacity].store(packed, std::memory_order_release);
+}
+
+void FrameProfiler::report(std::ostream& os) const {
+    std::array<std::vector<double>, static_cast<size_t>(FrameStage::Count)> stageMs;
+
+    size_t count = std::min<uint64_t>(writeIndex.load(std::memory_order_acquire), capacity);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t packed = samples[i].load(std::memory_order_acquire);
+        size_t stage = static_cast<size_t>(packed >> stageShift);
+        if (stage < stageMs.size()) {
+            stageMs[stage].push_back((packed & durationMask) / 1'000'000.0);
+        }
+    }
+
+    os << "CPU frame stages [ms] (p50 / p95 / p99):" << std::endl;
+    for (size_t i = 0; i < stageMs.size(); i++) {
+        if (stageMs[i].empty()) {
+            continue;
+        }
+        os << "\t" << stageName(static_cast<FrameStage>(i)) << ": "
+           << percentile(stageMs[i], 50) << " / "
+           << percentile(stageMs[i], 95) << " / "
+           << percentile(stageMs[i], 99)
+           << " (" << stageMs[i].size() << " samples)" << std::endl;
+    }
+}
+
+const char* FrameProfiler::stageName(FrameStage stage) {
+    switch (stage) {
+    case FrameStage::PollEvents: return "poll events";
+    case FrameStage::WaitFrame: return "wait frame";
+    case FrameStage::Acquire: return "acquire";
+    case FrameStage::Record: return "record";
+    case FrameStage::Submit: return "submit";
+    case FrameStage::Present: return "present";
+    default: return "unknown";
+    }
+}
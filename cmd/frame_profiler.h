@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// レンダーループのCPU側の処理段階
+enum class FrameStage : uint8_t {
+    PollEvents, // glfwPollEvents()
+    WaitFrame,  // フレームスロットのGPU処理完了待ち
+    Acquire,    // acquireNextImageKHR()
+    Record,     // コマンドの記録
+    Submit,     // キューへの投入
+    Present,    // presentKHR()
+    Count,
+};
+
+// フレームの処理段階ごとのCPU時間を計測する軽量なプロファイラ
+//  計測値はロックフリーのリングバッファに書き込み(古いものから上書き)、
+//  終了時に段階ごとの p50/p95/p99 を出力する
+class FrameProfiler {
+public:
+    explicit FrameProfiler(size_t capacity = 1 << 18);
+
+    // 段階の計測を開始/終了する (レンダーループのスレッドから呼ぶ)
+    void begin(FrameStage stage);
+    void end(FrameStage stage);
+
+    // 計測値を記録する (どのスレッドからでも呼べる)
+    void record(FrameStage stage, uint64_t durationNs);
+
+    // リングバッファに残っている計測値から段階ごとの分布を出力する
+    void report(std::ostream& os) const;
+
+    static const char* stageName(FrameStage stage);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 1要素に段階(上位8bit)と時間(下位56bit, ns)を詰めて、読み書きを1回のアトミック操作で行う
+    static constexpr int stageShift = 56;
+    static constexpr uint64_t durationMask = (uint64_t(1) << stageShift) - 1;
+
+    size_t capacity;
+    std::unique_ptr<std::atomic<uint64_t>[]> samples;
+    std::atomic<uint64_t> writeIndex;
+
+    std::array<Clock::time_point, static_cast<size_t>(FrameStage::Count)> stageStart;
+};
@@ -0,0 +1,39 @@
+#include "frame_ring.h"
+
+#include <algorithm>
+
+FrameRing::FrameRing(vk::Device device, FrameScheduler& scheduler, uint32_t queueFamilyIndex, uint32_t slotCount)
+    : scheduler(scheduler), current(0) {
+    slotCount = std::max(slotCount, 1u);
+
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    cmdPool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+
+    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+    cmdBufAllocInfo.commandPool = cmdPool.get();
+    cmdBufAllocInfo.commandBufferCount = slotCount;
+    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo;
+
+    slots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        slots[i].cmdBuf = std::move(cmdBufs[i]);
+        slots[i].swapchainImgSemaphore = device.createSemaphoreUnique(semaphoreCreateInfo);
+    }
+
+    // 最初のacquire()でスロット0を返すために末尾を指しておく
+    current = slotCount - 1;
+}
+
+FrameSlot& FrameRing::acquire() {
+    current = (current + 1) % slots.size();
+
+    FrameSlot& slot = slots[current];
+    // まだ一度も投入していないスロットの値は0なので待たずに返る
+    scheduler.wait(slot.timelineValue);
+    return slot;
+}
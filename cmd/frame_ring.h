@@ -0,0 +1,34 @@
+#pragma once
+
+#include "frame_scheduler.h"
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+
+// 1フレーム分の記録と同期に必要なオブジェクト一式
+struct FrameSlot {
+    vk::UniqueCommandBuffer cmdBuf;
+    vk::UniqueSemaphore swapchainImgSemaphore; // スワップチェーン画像の取得完了 (描画完了のセマフォはスワップチェーン画像ごとに持つ)
+    uint64_t timelineValue = 0;                // このスロットを最後に投入した時のタイムライン値
+};
+
+// N個のフレームスロットを順番に使い回すリング
+//  CPUがスロットiを記録している間、GPUは他のスロットを実行できる
+class FrameRing {
+public:
+    FrameRing(vk::Device device, FrameScheduler& scheduler, uint32_t queueFamilyIndex, uint32_t slotCount);
+
+    // 次のスロットへ進め、そのスロットの前回のGPU処理が終わるまで待つ
+    FrameSlot& acquire();
+
+    uint32_t size() const { return static_cast<uint32_t>(slots.size()); }
+
+    // 最後に acquire() したスロットの番号
+    uint32_t currentIndex() const { return current; }
+
+private:
+    FrameScheduler& scheduler;
+    vk::UniqueCommandPool cmdPool;
+    std::vector<FrameSlot> slots;
+    uint32_t current;
+};
@@ -0,0 +1,135 @@
+#include "frame_scheduler.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+FrameScheduler::FrameScheduler(vk::Device device) : device(device), lastSubmitted(0) {
+    vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+    semaphoreTypeCreateInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+    timeline = device.createSemaphoreUnique(semaphoreCreateInfo);
+}
+
+FrameScheduler::~FrameScheduler() {
+    // 投入済みの処理が全て終わってから遅延処理を実行する
+    try {
+        wait(submittedValue());
+        retire();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+bool FrameScheduler::isSupported(vk::PhysicalDevice physicalDevice) {
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+    return features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore;
+}
+
+uint64_t FrameScheduler::submit(vk::Queue queue, const vk::SubmitInfo& submitInfo) {
+    return submit(queue, submitInfo, {});
+}
+
+uint64_t FrameScheduler::submit(vk::Queue queue, const vk::SubmitInfo& submitInfo, const std::vector<TimelineWait>& timelineWaits) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t value = lastSubmitted + 1;
+
+    // 既存のシグナルセマフォ(バイナリ)の後ろにタイムラインセマフォを追加する
+    std::vector<vk::Semaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    signalSemaphores.push_back(timeline.get());
+
+    // バイナリセマフォに対応する値は無視されるため0を入れておく
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+    signalValues.back() = value;
+
+    // 既存の待機セマフォ(バイナリ)の後ろに、他のタイムラインセマフォの待機を追加する
+    std::vector<vk::Semaphore> waitSemaphores(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+    std::vector<vk::PipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+    std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+    for (const TimelineWait& wait : timelineWaits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitStages.push_back(wait.stage);
+        waitValues.push_back(wait.value);
+    }
+
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+    timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+    if (!timelineWaits.empty()) {
+        timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    }
+
+    vk::SubmitInfo timelineSubmit = submitInfo;
+    timelineSubmit.pNext = &timelineSubmitInfo;
+    timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+    timelineSubmit.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    timelineSubmit.pWaitSemaphores = waitSemaphores.data();
+    timelineSubmit.pWaitDstStageMask = waitStages.data();
+
+    queue.submit({ timelineSubmit });
+
+    lastSubmitted = value;
+    return value;
+}
+
+uint64_t FrameScheduler::completedValue() const {
+    return device.getSemaphoreCounterValue(timeline.get());
+}
+
+uint64_t FrameScheduler::submittedValue() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSubmitted;
+}
+
+void FrameScheduler::wait(uint64_t value) const {
+    if (value == 0) {
+        return;
+    }
+
+    vk::Semaphore semaphores[] = { timeline.get() };
+    uint64_t values[] = { value };
+
+    vk::SemaphoreWaitInfo waitInfo;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = semaphores;
+    waitInfo.pValues = values;
+
+    if (device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("タイムラインセマフォの待機に失敗しました。");
+    }
+}
+
+void FrameScheduler::onRetire(uint64_t value, std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retireCallbacks.emplace(value, std::move(callback));
+}
+
+void FrameScheduler::retire() {
+    uint64_t completed = completedValue();
+
+    // コールバック内から onRetire() を呼べるようにロックの外で実行する
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto end = retireCallbacks.upper_bound(completed);
+        for (auto it = retireCallbacks.begin(); it != end; ++it) {
+            callbacks.push_back(std::move(it->second));
+        }
+        retireCallbacks.erase(retireCallbacks.begin(), end);
+    }
+
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
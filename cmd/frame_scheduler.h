@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Vulkan 1.2 のタイムラインセマフォによるフレームスケジューラ
+//  投入した処理ごとに単調増加する値をシグナルさせ、
+//  「値K(=フレームK)の処理が終わったか」をどのスレッドからでも待てるようにする。
+//  フェンスのリセットが不要になり、アップロード・描画・読み戻しを同じカウンタで順序付けできる。
+class FrameScheduler {
+public:
+    // 投入時に待つ他のタイムラインセマフォの値 (別のキューのスケジューラの完了を待つ場合など)
+    struct TimelineWait {
+        vk::Semaphore semaphore;
+        uint64_t value;
+        vk::PipelineStageFlags stage;
+    };
+
+    explicit FrameScheduler(vk::Device device);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // タイムラインセマフォとデバイス機能をサポートしているか確認する
+    static bool isSupported(vk::PhysicalDevice physicalDevice);
+
+    // submitInfo のシグナルにタイムライン値を追加してキューへ投入し、その値を返す
+    uint64_t submit(vk::Queue queue, const vk::SubmitInfo& submitInfo);
+
+    // submitInfo の待機セマフォに timelineWaits を追加して投入する
+    uint64_t submit(vk::Queue queue, const vk::SubmitInfo& submitInfo, const std::vector<TimelineWait>& timelineWaits);
+
+    // GPUが完了させた最新の値
+    uint64_t completedValue() const;
+
+    // 最後に投入した処理の値
+    uint64_t submittedValue() const;
+
+    // 値 value の処理が完了するまで待つ (スレッドセーフ)
+    void wait(uint64_t value) const;
+
+    // 値 value の処理が完了した後に実行する処理を登録する (リソースの遅延破棄など)
+    void onRetire(uint64_t value, std::function<void()> callback);
+
+    // 値 value の処理が完了するまで resource (UniqueHandleやそのvectorなど) の破棄を遅らせる
+    template <typename T>
+    void destroyAfter(uint64_t value, T resource) {
+        auto holder = std::make_shared<T>(std::move(resource));
+        onRetire(value, [holder]() mutable { holder.reset(); });
+    }
+
+    // 完了済みの値に登録された処理を実行する
+    void retire();
+
+    vk::Semaphore semaphore() const { return timeline.get(); }
+
+private:
+    vk::Device device;
+    vk::UniqueSemaphore timeline;
+
+    mutable std::mutex mutex;
+    uint64_t lastSubmitted;
+    std::multimap<uint64_t, std::function<void()>> retireCallbacks;
+};
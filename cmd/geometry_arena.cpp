@@ -0,0 +1,88 @@
+#include "geometry_arena.h"
+#include "memory_type.h"
+#include "upload_context.h"
+
+#include <cstring>
+#include <stdexcept>
+
+GeometryArena::GeometryArena(DeviceAllocator& allocator, uint32_t vertexStride, uint32_t maxVertices, uint32_t maxIndices, vk::IndexType indexType)
+    : vertexStride(vertexStride),
+      indexSize(indexType == vk::IndexType::eUint32 ? 4 : 2),
+      arenaIndexType(indexType),
+      maxVertices(maxVertices),
+      maxIndices(maxIndices),
+      vertexCount(0),
+      indexCount(0),
+      uploadedVertices(0),
+      uploadedIndices(0),
+      meshCount(0) {
+    // インデックスの領域は bindIndexBuffer() のオフセットの制約 (インデックスサイズの倍数) を満たすように揃える
+    indexRegionBegin = (vk::DeviceSize(vertexStride) * maxVertices + 15) / 16 * 16;
+    vk::DeviceSize arenaSize = indexRegionBegin + vk::DeviceSize(indexSize) * maxIndices;
+    hostData.resize(arenaSize);
+
+    vk::Device device = allocator.getDevice();
+
+    vk::BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.size = arenaSize;
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    arenaBuf = device.createBufferUnique(bufferCreateInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(arenaBuf.get());
+    uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (memTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("ジオメトリ領域に使えるメモリタイプが存在しません。");
+    }
+    arenaMemory = allocator.allocateForBuffer(arenaBuf.get(), memTypeIndex, MemoryUsage::GpuOnly);
+}
+
+GeometryMesh GeometryArena::addMesh(const void* vertexData, uint32_t meshVertexCount, const void* indexData, uint32_t meshIndexCount) {
+    if (vertexCount + meshVertexCount > maxVertices || indexCount + meshIndexCount > maxIndices) {
+        throw std::runtime_error("ジオメトリ領域の容量が足りません。");
+    }
+
+    std::memcpy(hostData.data() + vk::DeviceSize(vertexStride) * vertexCount, vertexData, vk::DeviceSize(vertexStride) * meshVertexCount);
+    std::memcpy(hostData.data() + indexRegionBegin + vk::DeviceSize(indexSize) * indexCount, indexData, vk::DeviceSize(indexSize) * meshIndexCount);
+
+    GeometryMesh mesh;
+    mesh.firstIndex = indexCount;
+    mesh.indexCount = meshIndexCount;
+    mesh.vertexOffset = static_cast<int32_t>(vertexCount);
+    mesh.vertexCount = meshVertexCount;
+
+    vertexCount += meshVertexCount;
+    indexCount += meshIndexCount;
+    meshCount++;
+    return mesh;
+}
+
+void GeometryArena::stageUploads(UploadContext& uploadContext) {
+    // 同じバッファへの2領域として予約するため、UploadContext が1回の copyBuffer() にまとめる
+    //  バッファのメモリがホストから書き込める場合 (UMA) は UploadContext がステージングを経由せずに直接書き込む
+    if (vertexCount > uploadedVertices) {
+        vk::DeviceSize offset = vk::DeviceSize(vertexStride) * uploadedVertices;
+        uploadContext.uploadBuffer(arenaBuf.get(), arenaMemory, offset, hostData.data() + offset, vk::DeviceSize(vertexStride) * (vertexCount - uploadedVertices));
+        uploadedVertices = vertexCount;
+    }
+    if (indexCount > uploadedIndices) {
+        vk::DeviceSize offset = indexRegionBegin + vk::DeviceSize(indexSize) * uploadedIndices;
+        uploadContext.uploadBuffer(arenaBuf.get(), arenaMemory, offset, hostData.data() + offset, vk::DeviceSize(indexSize) * (indexCount - uploadedIndices));
+        uploadedIndices = indexCount;
+    }
+}
+
+void GeometryArena::bind(vk::CommandBuffer cmdBuf) const {
+    cmdBuf.bindVertexBuffers(0, {arenaBuf.get()}, {0});
+    cmdBuf.bindIndexBuffer(arenaBuf.get(), indexRegionBegin, arenaIndexType);
+}
+
+void GeometryArena::draw(vk::CommandBuffer cmdBuf, const GeometryMesh& mesh, uint32_t instanceCount) {
+    cmdBuf.drawIndexed(mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, 0);
+}
+
+void GeometryArena::report(std::ostream& os) const {
+    os << "geometry arena: " << meshCount << " meshes, vertices " << vertexCount << " / " << maxVertices
+       << ", indices " << indexCount << " / " << maxIndices
+       << " (" << hostData.size() / 1024 << " KiB buffer)" << std::endl;
+}
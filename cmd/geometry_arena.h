@@ -0,0 +1,68 @@
+#pragma once
+
+#include "device_allocator.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class UploadContext;
+
+// GeometryArena 内のメッシュの位置 (drawIndexed() の引数になる)
+struct GeometryMesh {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t vertexOffset = 0;   // インデックスに加算する頂点番号 (メッシュの先頭頂点)
+    uint32_t vertexCount = 0;
+};
+
+// 多数のメッシュの頂点とインデックスを、1つのデバイスローカルのバッファ (eVertexBuffer | eIndexBuffer) に詰めて格納する領域
+//  バッファの前半を頂点、後半をインデックスの領域とし、メッシュはオフセットで指す。
+//  シーン全体でバインドは頂点・インデックス各1回、アップロードは2領域の copyBuffer() 1回で済む。
+class GeometryArena {
+public:
+    // maxVertices 個の頂点 (vertexStride バイト) と maxIndices 個のインデックスを格納できるバッファを作成する
+    //  メモリタイプが見つからない場合は std::runtime_error を投げる
+    GeometryArena(DeviceAllocator& allocator, uint32_t vertexStride, uint32_t maxVertices, uint32_t maxIndices,
+                  vk::IndexType indexType = vk::IndexType::eUint16);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // メッシュの頂点とインデックスを詰め込み先に追加する (転送は stageUploads() で行う)
+    //  インデックスはメッシュの先頭頂点からの番号。容量が足りない場合は std::runtime_error を投げる
+    GeometryMesh addMesh(const void* vertexData, uint32_t vertexCount, const void* indexData, uint32_t indexCount);
+
+    // 前回以降に追加したメッシュの頂点とインデックスを uploadContext に予約する
+    //  詰め込み先のデータは uploadContext の submit() まで変更しないこと
+    //  バッファのメモリがホストから書き込める場合は submit() でステージングを経由せずに書き込まれる
+    void stageUploads(UploadContext& uploadContext);
+
+    // 頂点バッファ (binding 0) とインデックスバッファをバインドする。以降は draw() でメッシュを描画する
+    void bind(vk::CommandBuffer cmdBuf) const;
+    static void draw(vk::CommandBuffer cmdBuf, const GeometryMesh& mesh, uint32_t instanceCount = 1);
+
+    vk::Buffer buffer() const { return arenaBuf.get(); }
+    vk::DeviceSize indexRegionOffset() const { return indexRegionBegin; }
+    vk::IndexType indexType() const { return arenaIndexType; }
+
+    void report(std::ostream& os) const;
+
+private:
+    DeviceAllocation arenaMemory;
+    vk::UniqueBuffer arenaBuf;  // メモリより先に破棄する
+    uint32_t vertexStride;
+    uint32_t indexSize;
+    vk::IndexType arenaIndexType;
+    uint32_t maxVertices;
+    uint32_t maxIndices;
+    vk::DeviceSize indexRegionBegin;
+
+    std::vector<char> hostData;   // バッファと同じ配置の詰め込み先
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t uploadedVertices;
+    uint32_t uploadedIndices;
+    uint32_t meshCount;
+};
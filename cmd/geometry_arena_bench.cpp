@@ -0,0 +1,396 @@
+#include "geometry_arena_bench.h"
+#include "bench_context.h"
+#include "buffer_pool.h"
+#include "device_allocator.h"
+#include "frame_scheduler.h"
+#include "geometry_arena.h"
+#include "memory_type.h"
+#include "upload_context.h"
+
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Vec2 {
+    float x, y;
+};
+
+struct Vec3 {
+    float x, y, z;
+};
+
+struct Vertex {
+    Vec2 pos;
+    Vec3 color;
+};
+
+const uint32_t targetWidth = 256;
+const uint32_t targetHeight = 256;
+
+vk::UniqueShaderModule loadShader(vk::Device device, const char* path) {
+    size_t spvFileSz = std::filesystem::file_size(path);
+    std::ifstream spvFile(path, std::ios_base::binary);
+    std::vector<char> spvFileData(spvFileSz);
+    spvFile.read(spvFileData.data(), spvFileSz);
+
+    vk::ShaderModuleCreateInfo shaderCreateInfo;
+    shaderCreateInfo.codeSize = spvFileSz;
+    shaderCreateInfo.pCode = reinterpret_cast<const uint32_t *>(spvFileData.data());
+    return device.createShaderModuleUnique(shaderCreateInfo);
+}
+
+// 頂点・インデックスバッファを1つ作成し、デバイスローカルのメモリを割り当てる
+vk::UniqueBuffer createGpuBuffer(DeviceAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, DeviceAllocation& memory) {
+    vk::Device device = allocator.getDevice();
+
+    vk::BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage | vk::BufferUsageFlagBits::eTransferDst;
+    bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    vk::UniqueBuffer buffer = device.createBufferUnique(bufferCreateInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffer.get());
+    uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (memTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("適切なメモリタイプが存在しません。");
+    }
+    memory = allocator.allocateForBuffer(buffer.get(), memTypeIndex, MemoryUsage::GpuOnly);
+    return buffer;
+}
+
+}
+
+int GeometryArenaBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+    uint32_t meshCount = options.count > 0 ? options.count : 10000;
+
+    // 小さなメッシュ (四角形) を画面上に敷き詰める。メッシュごとに位置と色を変える
+    const uint32_t meshVertexCount = 4;
+    const uint32_t meshIndexCount = 6;
+    const uint16_t meshIndices[meshIndexCount] = {0, 1, 2, 1, 0, 3};
+    uint32_t columns = 1;
+    while (columns * columns < meshCount) {
+        columns++;
+    }
+    float cell = 2.0f / columns;
+    std::vector<Vertex> meshVertices(vk::DeviceSize(meshVertexCount) * meshCount);
+    for (uint32_t i = 0; i < meshCount; i++) {
+        float x = -1.0f + cell * (i % columns);
+        float y = -1.0f + cell * (i / columns);
+        Vec3 color{float(i % 7) / 6.0f, float(i % 11) / 10.0f, float(i % 13) / 12.0f};
+        Vertex* v = &meshVertices[vk::DeviceSize(meshVertexCount) * i];
+        v[0] = Vertex{Vec2{x, y}, color};
+        v[1] = Vertex{Vec2{x + cell, y + cell}, color};
+        v[2] = Vertex{Vec2{x, y + cell}, color};
+        v[3] = Vertex{Vec2{x + cell, y}, color};
+    }
+
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+    BufferPool bufferPool(allocator);
+
+    // 描画先のオフスクリーン画像とレンダーパス
+    const vk::Format targetFormat = vk::Format::eR8G8B8A8Unorm;
+
+    vk::ImageCreateInfo imageCreateInfo;
+    imageCreateInfo.imageType = vk::ImageType::e2D;
+    imageCreateInfo.format = targetFormat;
+    imageCreateInfo.extent = vk::Extent3D(targetWidth, targetHeight, 1);
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+    imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+    imageCreateInfo.usage = vk::ImageUsageFlagBits::eColorAttachment;
+    imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+    vk::UniqueImage targetImage = device.createImageUnique(imageCreateInfo);
+
+    vk::MemoryRequirements targetMemReq = device.getImageMemoryRequirements(targetImage.get());
+    uint32_t targetMemTypeIndex = selectMemoryType(allocator.memoryProperties(), targetMemReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (targetMemTypeIndex == UINT32_MAX) {
+        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+        return -1;
+    }
+    DeviceAllocation targetMemory = allocator.allocateForImage(targetImage.get(), targetMemTypeIndex, MemoryUsage::GpuOnly, vk::ImageTiling::eOptimal);
+
+    vk::ImageViewCreateInfo viewCreateInfo;
+    viewCreateInfo.image = targetImage.get();
+    viewCreateInfo.viewType = vk::ImageViewType::e2D;
+    viewCreateInfo.format = targetFormat;
+    viewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+    vk::UniqueImageView targetView = device.createImageViewUnique(viewCreateInfo);
+
+    vk::AttachmentDescription attachments[1];
+    attachments[0].format = targetFormat;
+    attachments[0].samples = vk::SampleCountFlagBits::e1;
+    attachments[0].loadOp = vk::AttachmentLoadOp::eClear;
+    attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+    attachments[0].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+    attachments[0].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+    attachments[0].initialLayout = vk::ImageLayout::eUndefined;
+    attachments[0].finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+    vk::AttachmentReference subpass0_attachmentRefs[1];
+    subpass0_attachmentRefs[0].attachment = 0;
+    subpass0_attachmentRefs[0].layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+    vk::SubpassDescription subpasses[1];
+    subpasses[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    subpasses[0].colorAttachmentCount = 1;
+    subpasses[0].pColorAttachments = subpass0_attachmentRefs;
+
+    vk::RenderPassCreateInfo renderpassCreateInfo;
+    renderpassCreateInfo.attachmentCount = 1;
+    renderpassCreateInfo.pAttachments = attachments;
+    renderpassCreateInfo.subpassCount = 1;
+    renderpassCreateInfo.pSubpasses = subpasses;
+    vk::UniqueRenderPass renderpass = device.createRenderPassUnique(renderpassCreateInfo);
+
+    vk::ImageView frameBufAttachments[1] = {targetView.get()};
+    vk::FramebufferCreateInfo frameBufCreateInfo;
+    frameBufCreateInfo.width = targetWidth;
+    frameBufCreateInfo.height = targetHeight;
+    frameBufCreateInfo.layers = 1;
+    frameBufCreateInfo.renderPass = renderpass.get();
+    frameBufCreateInfo.attachmentCount = 1;
+    frameBufCreateInfo.pAttachments = frameBufAttachments;
+    vk::UniqueFramebuffer framebuf = device.createFramebufferUnique(frameBufCreateInfo);
+
+    // サンプル5と同じ頂点形式のパイプライン
+    vk::Viewport viewports[1];
+    viewports[0].width = targetWidth;
+    viewports[0].height = targetHeight;
+    viewports[0].minDepth = 0.0f;
+    viewports[0].maxDepth = 1.0f;
+
+    vk::Rect2D scissors[1];
+    scissors[0].extent = vk::Extent2D(targetWidth, targetHeight);
+
+    vk::PipelineViewportStateCreateInfo viewportState;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = viewports;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = scissors;
+
+    vk::VertexInputBindingDescription vertexBindingDescription[1];
+    vertexBindingDescription[0].binding = 0;
+    vertexBindingDescription[0].stride = sizeof(Vertex);
+    vertexBindingDescription[0].inputRate = vk::VertexInputRate::eVertex;
+
+    vk::VertexInputAttributeDescription vertexInputDescription[2];
+    vertexInputDescription[0].binding = 0;
+    vertexInputDescription[0].location = 0;
+    vertexInputDescription[0].format = vk::Format::eR32G32Sfloat;
+    vertexInputDescription[0].offset = offsetof(Vertex, pos);
+    vertexInputDescription[1].binding = 0;
+    vertexInputDescription[1].location = 1;
+    vertexInputDescription[1].format = vk::Format::eR32G32B32Sfloat;
+    vertexInputDescription[1].offset = offsetof(Vertex, color);
+
+    vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
+    vertexInputInfo.vertexBindingDescriptionCount = std::size(vertexBindingDescription);
+    vertexInputInfo.pVertexBindingDescriptions = vertexBindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = std::size(vertexInputDescription);
+    vertexInputInfo.pVertexAttributeDescriptions = vertexInputDescription;
+
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+    inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+    inputAssembly.primitiveRestartEnable = false;
+
+    vk::PipelineRasterizationStateCreateInfo rasterizer;
+    rasterizer.depthClampEnable = false;
+    rasterizer.rasterizerDiscardEnable = false;
+    rasterizer.polygonMode = vk::PolygonMode::eFill;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = vk::CullModeFlagBits::eNone;
+    rasterizer.frontFace = vk::FrontFace::eClockwise;
+    rasterizer.depthBiasEnable = false;
+
+    vk::PipelineMultisampleStateCreateInfo multisample;
+    multisample.sampleShadingEnable = false;
+    multisample.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+    vk::PipelineColorBlendAttachmentState blendattachment[1];
+    blendattachment[0].colorWriteMask = vk::ColorComponentFlagBits::eA | vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB;
+    blendattachment[0].blendEnable = false;
+
+    vk::PipelineColorBlendStateCreateInfo blend;
+    blend.logicOpEnable = false;
+    blend.attachmentCount = 1;
+    blend.pAttachments = blendattachment;
+
+    vk::PipelineLayoutCreateInfo layoutCreateInfo;
+    vk::UniquePipelineLayout pipelineLayout = device.createPipelineLayoutUnique(layoutCreateInfo);
+
+    vk::UniqueShaderModule vertShader = loadShader(device, "../shader/shader.vert2.spv");
+    vk::UniqueShaderModule fragShader = loadShader(device, "../shader/shader.frag2.spv");
+
+    vk::PipelineShaderStageCreateInfo shaderStage[2];
+    shaderStage[0].stage = vk::ShaderStageFlagBits::eVertex;
+    shaderStage[0].module = vertShader.get();
+    shaderStage[0].pName = "main";
+    shaderStage[1].stage = vk::ShaderStageFlagBits::eFragment;
+    shaderStage[1].module = fragShader.get();
+    shaderStage[1].pName = "main";
+
+    vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    pipelineCreateInfo.pRasterizationState = &rasterizer;
+    pipelineCreateInfo.pMultisampleState = &multisample;
+    pipelineCreateInfo.pColorBlendState = &blend;
+    pipelineCreateInfo.layout = pipelineLayout.get();
+    pipelineCreateInfo.renderPass = renderpass.get();
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.stageCount = std::size(shaderStage);
+    pipelineCreateInfo.pStages = shaderStage;
+    vk::UniquePipeline pipeline = device.createGraphicsPipelineUnique(nullptr, pipelineCreateInfo).value;
+
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.queueFamilyIndex = ctx.getQueueFamilyIndex();
+    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    vk::UniqueCommandPool cmdPool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+
+    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+    cmdBufAllocInfo.commandPool = cmdPool.get();
+    cmdBufAllocInfo.commandBufferCount = 1;
+    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+    vk::CommandBuffer cmdBuf = cmdBufs[0].get();
+
+    // 全メッシュの描画を記録して投入し、完了を待つ。記録にかかった時間を返す
+    //  recordMeshes はレンダーパス内でバインドと描画を記録し、バインドの回数を返す
+    auto drawScene = [&](FrameScheduler& scheduler, auto recordMeshes, uint64_t& bindCount) {
+        Clock::time_point start = Clock::now();
+        cmdBuf.reset();
+        vk::CommandBufferBeginInfo cmdBeginInfo;
+        cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        cmdBuf.begin(cmdBeginInfo);
+
+        vk::ClearValue clearVal[1];
+        clearVal[0].color.float32[0] = 0.0f;
+        clearVal[0].color.float32[1] = 0.0f;
+        clearVal[0].color.float32[2] = 0.0f;
+        clearVal[0].color.float32[3] = 1.0f;
+
+        vk::RenderPassBeginInfo renderpassBeginInfo;
+        renderpassBeginInfo.renderPass = renderpass.get();
+        renderpassBeginInfo.framebuffer = framebuf.get();
+        renderpassBeginInfo.renderArea = vk::Rect2D({0, 0}, {targetWidth, targetHeight});
+        renderpassBeginInfo.clearValueCount = 1;
+        renderpassBeginInfo.pClearValues = clearVal;
+
+        cmdBuf.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        bindCount = recordMeshes(cmdBuf);
+        cmdBuf.endRenderPass();
+        cmdBuf.end();
+        double recordSeconds = elapsedSeconds(start);
+
+        vk::CommandBuffer submitCmdBuf[1] = {cmdBuf};
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = submitCmdBuf;
+        scheduler.wait(scheduler.submit(ctx.getQueue(), submitInfo));
+        scheduler.retire();
+        return recordSeconds;
+    };
+
+    vk::DeviceSize meshVertexBytes = sizeof(Vertex) * meshVertexCount;
+    vk::DeviceSize meshIndexBytes = sizeof(uint16_t) * meshIndexCount;
+
+    std::cout << meshCount << " meshes (" << meshVertexCount << " vertices, " << meshIndexCount << " indices each)" << std::endl;
+
+    // メッシュごとに頂点バッファとインデックスバッファを作成する
+    {
+        // アップロードのコンテキストをスケジューラより先に作成する (コマンドバッファの破棄はスケジューラが完了を待った後)
+        UploadContext uploadContext(bufferPool, device, ctx.getQueueFamilyIndex());
+        FrameScheduler scheduler(device);
+
+        Clock::time_point start = Clock::now();
+        std::vector<vk::UniqueBuffer> vertexBufs(meshCount);
+        std::vector<vk::UniqueBuffer> indexBufs(meshCount);
+        std::vector<DeviceAllocation> vertexBufMemories(meshCount);
+        std::vector<DeviceAllocation> indexBufMemories(meshCount);
+        for (uint32_t i = 0; i < meshCount; i++) {
+            vertexBufs[i] = createGpuBuffer(allocator, meshVertexBytes, vk::BufferUsageFlagBits::eVertexBuffer, vertexBufMemories[i]);
+            indexBufs[i] = createGpuBuffer(allocator, meshIndexBytes, vk::BufferUsageFlagBits::eIndexBuffer, indexBufMemories[i]);
+            uploadContext.uploadBuffer(vertexBufs[i].get(), 0, &meshVertices[vk::DeviceSize(meshVertexCount) * i], meshVertexBytes);
+            uploadContext.uploadBuffer(indexBufs[i].get(), 0, meshIndices, meshIndexBytes);
+        }
+        uploadContext.submit(scheduler, ctx.getQueue()).wait();
+        scheduler.retire();
+        double setupSeconds = elapsedSeconds(start);
+
+        uint64_t bindCount = 0;
+        double recordSeconds = drawScene(scheduler, [&](vk::CommandBuffer cmdBuf) -> uint64_t {
+            for (uint32_t i = 0; i < meshCount; i++) {
+                cmdBuf.bindVertexBuffers(0, {vertexBufs[i].get()}, {0});
+                cmdBuf.bindIndexBuffer(indexBufs[i].get(), 0, vk::IndexType::eUint16);
+                cmdBuf.drawIndexed(meshIndexCount, 1, 0, 0, 0);
+            }
+            return uint64_t(meshCount) * 2;
+        }, bindCount);
+
+        std::cout << "per-mesh buffers: " << meshCount * 2 << " buffers, " << meshCount * 2 << " copy commands"
+                  << ", setup " << setupSeconds * 1000.0 << " ms"
+                  << ", record " << recordSeconds * 1000.0 << " ms, " << bindCount << " binds" << std::endl;
+        allocator.report(std::cout);
+    }
+
+    // GeometryArena で1つのバッファに詰め、シーン全体で1回だけバインドする
+    {
+        UploadContext uploadContext(bufferPool, device, ctx.getQueueFamilyIndex());
+        FrameScheduler scheduler(device);
+
+        Clock::time_point start = Clock::now();
+        GeometryArena geometryArena(allocator, sizeof(Vertex), meshVertexCount * meshCount, meshIndexCount * meshCount);
+        std::vector<GeometryMesh> meshes(meshCount);
+        for (uint32_t i = 0; i < meshCount; i++) {
+            meshes[i] = geometryArena.addMesh(&meshVertices[vk::DeviceSize(meshVertexCount) * i], meshVertexCount, meshIndices, meshIndexCount);
+        }
+        geometryArena.stageUploads(uploadContext);
+        uploadContext.submit(scheduler, ctx.getQueue()).wait();
+        scheduler.retire();
+        double setupSeconds = elapsedSeconds(start);
+
+        uint64_t bindCount = 0;
+        double recordSeconds = drawScene(scheduler, [&](vk::CommandBuffer cmdBuf) -> uint64_t {
+            geometryArena.bind(cmdBuf);
+            for (const GeometryMesh& mesh : meshes) {
+                GeometryArena::draw(cmdBuf, mesh);
+            }
+            return 2;
+        }, bindCount);
+
+        // UMAでバッファのメモリがホストから書き込める場合はコピーせずに直接書き込む
+        std::cout << "geometry arena: 1 buffer, " << (uploadContext.stats().directUploads > 0 ? "direct write" : "1 copy command (2 regions)")
+                  << ", setup " << setupSeconds * 1000.0 << " ms"
+                  << ", record " << recordSeconds * 1000.0 << " ms, " << bindCount << " binds" << std::endl;
+        geometryArena.report(std::cout);
+        allocator.report(std::cout);
+    }
+
+    bufferPool.report(std::cout);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// 多数のメッシュ (既定値: 10000個) について、メッシュごとに頂点・インデックスバッファを作る方法と
+// GeometryArena で1つのバッファに詰める方法の、準備(作成とアップロード)と描画の記録にかかるCPU時間とバインド数を比較するベンチマーク
+class GeometryArenaBench : public Command {
+public:
+    GeometryArenaBench(const BenchOptions& options) : options(options) {};
+    ~GeometryArenaBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
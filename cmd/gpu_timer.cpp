@@ -0,0 +1,109 @@
+#include "gpu_timer.h"
+#include "frame_counter.h"
+
+#include <iostream>
+
+GpuTimer::GpuTimer(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                   bool enabled, uint32_t slotCount, uint32_t maxScopesPerSlot)
+    : device(device),
+      enabled(enabled),
+      maxScopes(maxScopesPerSlot),
+      timestampPeriodNs(0.0),
+      timestampMask(0),
+      currentSlot(nullptr) {
+    if (!enabled) {
+        return;
+    }
+
+    // タイムスタンプの有効ビット数が0のキューファミリーではタイムスタンプを書き込めない
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0) {
+        std::cerr << "このキューファミリーはタイムスタンプクエリに対応していません。" << std::endl;
+        this->enabled = false;
+        return;
+    }
+    timestampMask = validBits >= 64 ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+
+    // 1カウントあたりのナノ秒数
+    timestampPeriodNs = physicalDevice.getProperties().limits.timestampPeriod;
+
+    vk::QueryPoolCreateInfo queryPoolCreateInfo;
+    queryPoolCreateInfo.queryType = vk::QueryType::eTimestamp;
+    queryPoolCreateInfo.queryCount = maxScopes * 2;
+
+    slots.resize(slotCount);
+    for (Slot& slot : slots) {
+        slot.queryPool = device.createQueryPoolUnique(queryPoolCreateInfo);
+    }
+}
+
+void GpuTimer::beginFrame(vk::CommandBuffer cmdBuf, uint32_t slotIndex) {
+    if (!enabled) {
+        return;
+    }
+
+    currentSlot = &slots[slotIndex];
+    collect(*currentSlot);
+
+    cmdBuf.resetQueryPool(currentSlot->queryPool.get(), 0, maxScopes * 2);
+}
+
+uint32_t GpuTimer::beginScope(vk::CommandBuffer cmdBuf, const char* name) {
+    if (!enabled || !currentSlot || currentSlot->scopeNames.size() >= maxScopes) {
+        return UINT32_MAX;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(currentSlot->scopeNames.size());
+    currentSlot->scopeNames.push_back(name);
+
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, currentSlot->queryPool.get(), scope * 2);
+    return scope;
+}
+
+void GpuTimer::endScope(vk::CommandBuffer cmdBuf, uint32_t scope) {
+    if (!enabled || !currentSlot || scope == UINT32_MAX) {
+        return;
+    }
+
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, currentSlot->queryPool.get(), scope * 2 + 1);
+}
+
+void GpuTimer::collect(Slot& slot) {
+    if (slot.scopeNames.empty()) {
+        return;
+    }
+
+    // スロットの前回の投入分は完了しているため待たずに読み出せる
+    uint32_t queryCount = static_cast<uint32_t>(slot.scopeNames.size()) * 2;
+    std::vector<uint64_t> timestamps(queryCount);
+    vk::Result result = device.getQueryPoolResults(slot.queryPool.get(), 0, queryCount,
+        timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    if (result == vk::Result::eSuccess) {
+        for (size_t i = 0; i < slot.scopeNames.size(); i++) {
+            std::vector<double>& samples = scopeMs[slot.scopeNames[i]];
+            if (samples.size() >= maxSamples) {
+                continue;
+            }
+            uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+            samples.push_back(ticks * timestampPeriodNs / 1'000'000.0);
+        }
+    }
+
+    slot.scopeNames.clear();
+}
+
+void GpuTimer::report(std::ostream& os) const {
+    if (!enabled) {
+        return;
+    }
+
+    os << "GPU time [ms] (p50 / p95 / p99):" << std::endl;
+    for (const auto& [name, samples] : scopeMs) {
+        os << "\t" << name << ": "
+           << percentile(samples, 50) << " / "
+           << percentile(samples, 95) << " / "
+           << percentile(samples, 99)
+           << " (" << samples.size() << " samples)" << std::endl;
+    }
+}
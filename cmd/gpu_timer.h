@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// タイムスタンプクエリによるGPU側の処理時間の計測
+//  フレームスロットごとにクエリプールを持ち、スロットが再利用される時(=前回の投入分の完了後)に
+//  結果を読み戻すため、読み戻しでフレームが止まることはない
+class GpuTimer {
+public:
+    GpuTimer(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+             bool enabled, uint32_t slotCount, uint32_t maxScopesPerSlot = 64);
+
+    bool isEnabled() const { return enabled; }
+
+    // コマンド記録の先頭(レンダーパスの外)で呼ぶ
+    //  スロットの前回の結果を集計し、クエリをリセットするコマンドを記録する
+    void beginFrame(vk::CommandBuffer cmdBuf, uint32_t slotIndex);
+
+    // 計測区間の開始と終了のタイムスタンプを書き込む。区間数が上限を超えた場合は計測しない
+    uint32_t beginScope(vk::CommandBuffer cmdBuf, const char* name);
+    void endScope(vk::CommandBuffer cmdBuf, uint32_t scope);
+
+    // 区間名ごとのGPU時間の分布を出力する
+    void report(std::ostream& os) const;
+
+private:
+    struct Slot {
+        vk::UniqueQueryPool queryPool;
+        std::vector<std::string> scopeNames; // 前回記録した区間 (区間i → クエリ2i, 2i+1)
+    };
+
+    void collect(Slot& slot);
+
+    // 長時間の実行でもメモリが増え続けないように、区間ごとに保持するサンプル数の上限
+    static constexpr size_t maxSamples = 1 << 20;
+
+    vk::Device device;
+    bool enabled;
+    uint32_t maxScopes;
+    double timestampPeriodNs;
+    uint64_t timestampMask;
+
+    std::vector<Slot> slots;
+    Slot* currentSlot;
+
+    std::map<std::string, std::vector<double>> scopeMs;
+};
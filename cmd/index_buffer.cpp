@@ -1,9 +1,18 @@
 #include "index_buffer.h"
+#include "frame_scheduler.h"
+#include "frame_ring.h"
+#include "frame_counter.h"
+#include "frame_profiler.h"
+#include "gpu_timer.h"
+#include "pipeline_stats.h"
+#include "present_mode.h"
+#include "sample_window.h"
+#include "memory_type.h"
+#include "mapped_copy.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <vulkan/vulkan.hpp>
-#include <GLFW/glfw3.h>
 
 const uint32_t screenWidth = 640;
 const uint32_t screenHeight = 480;
@@ -32,40 +41,28 @@ static std::vector<uint16_t> indices = { 0, 1, 2, 1, 0, 3 };
 
 
 int IndexBuffer::execute() {
-    if (!glfwInit())
+    // 表示先の準備 (ヘッドレスモードではウインドウを作成しない)
+    SampleWindow sampleWindow(options);
+    if (!sampleWindow.init())
         return -1;
 
-    uint32_t requiredExtensionsCount;
-    const char** requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
+    std::vector<const char*> requiredExtensions = sampleWindow.requiredInstanceExtensions();
+
+    // タイムラインセマフォを使うためVulkan 1.2を要求する
+    vk::ApplicationInfo appInfo;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     vk::InstanceCreateInfo createInfo;
-    createInfo.enabledExtensionCount = requiredExtensionsCount;
-    createInfo.ppEnabledExtensionNames = requiredExtensions;
+    createInfo.pApplicationInfo = &appInfo;
+    createInfo.enabledExtensionCount = requiredExtensions.size();
+    createInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
     vk::UniqueInstance instance;
     instance = vk::createInstanceUnique(createInfo);
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow* window;
-    window = glfwCreateWindow(screenWidth, screenHeight, "GLFW Test Window", NULL, NULL);
-    if (!window) {
-        const char* err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
+    vk::UniqueSurfaceKHR surface = sampleWindow.createSurface(instance.get(), screenWidth, screenHeight, "GLFW Test Window");
+    if (!surface)
         return -1;
-    }
-
-    VkSurfaceKHR c_surface;
-    auto result = glfwCreateWindowSurface(instance.get(), window, nullptr, &c_surface);
-    if (result != VK_SUCCESS) {
-        const char* err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    vk::UniqueSurfaceKHR surface{ c_surface, instance.get() };
 
     std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
 
@@ -96,7 +93,7 @@ int IndexBuffer::execute() {
             }
         }
 
-        if (existsGraphicsQueue && supportsSwapchainExtension) {
+        if (existsGraphicsQueue && supportsSwapchainExtension && FrameScheduler::isSupported(physicalDevices[i])) {
             physicalDevice = physicalDevices[i];
             existsSuitablePhysicalDevice = true;
             break;
@@ -126,10 +123,27 @@ int IndexBuffer::execute() {
     devCreateInfo.pQueueCreateInfos = queueCreateInfo;
     devCreateInfo.queueCreateInfoCount = 1;
 
+    // タイムラインセマフォを有効にする
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    devCreateInfo.pNext = &timelineSemaphoreFeatures;
+
+    // パイプライン統計クエリを使う場合は機能を有効にする
+    bool pipelineStatsEnabled = options.pipelineStats && PipelineStats::isSupported(physicalDevice);
+    if (options.pipelineStats && !pipelineStatsEnabled) {
+        std::cerr << "このデバイスはパイプライン統計クエリに対応していません。" << std::endl;
+    }
+    vk::PhysicalDeviceFeatures enabledFeatures;
+    enabledFeatures.pipelineStatisticsQuery = pipelineStatsEnabled;
+    devCreateInfo.pEnabledFeatures = &enabledFeatures;
+
     vk::UniqueDevice device = physicalDevice.createDeviceUnique(devCreateInfo);
 
     vk::Queue graphicsQueue = device->getQueue(graphicsQueueFamilyIndex, 0);
 
+    // GPUの処理完了をタイムライン値で管理するスケジューラ
+    FrameScheduler scheduler(device.get());
+
     vk::PhysicalDeviceMemoryProperties memProps = physicalDevice.getMemoryProperties();
 
     vk::BufferCreateInfo vertBufferCreateInfo;
@@ -144,16 +158,8 @@ int IndexBuffer::execute() {
     vk::MemoryAllocateInfo vertexBufMemAllocInfo;
     vertexBufMemAllocInfo.allocationSize = vertexBufMemReq.size;
 
-    bool suitableMemoryTypeFound = false;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if (vertexBufMemReq.memoryTypeBits & (1 << i) &&
-            (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
-            vertexBufMemAllocInfo.memoryTypeIndex = i;
-            suitableMemoryTypeFound = true;
-            break;
-        }
-    }
-    if (!suitableMemoryTypeFound) {
+    vertexBufMemAllocInfo.memoryTypeIndex = selectMemoryType(memProps, vertexBufMemReq.memoryTypeBits, MemoryUsage::Dynamic);
+    if (vertexBufMemAllocInfo.memoryTypeIndex == UINT32_MAX) {
         std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
         return -1;
     }
@@ -164,7 +170,7 @@ int IndexBuffer::execute() {
 
     void* vertexBufMem = device->mapMemory(vertexBufMemory.get(), 0, sizeof(Vertex) * vertices.size());
 
-    std::memcpy(vertexBufMem, vertices.data(), sizeof(Vertex) * vertices.size());
+    copyToMapped(vertexBufMem, vertices.data(), sizeof(Vertex) * vertices.size());
 
     vk::MappedMemoryRange flushMemoryRange;
     flushMemoryRange.memory = vertexBufMemory.get();
@@ -187,16 +193,8 @@ int IndexBuffer::execute() {
     vk::MemoryAllocateInfo indexBufMemAllocInfo;
     indexBufMemAllocInfo.allocationSize = indexBufMemReq.size;
 
-    suitableMemoryTypeFound = false;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if (indexBufMemReq.memoryTypeBits & (1 << i) &&
-            (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
-            indexBufMemAllocInfo.memoryTypeIndex = i;
-            suitableMemoryTypeFound = true;
-            break;
-        }
-    }
-    if (!suitableMemoryTypeFound) {
+    indexBufMemAllocInfo.memoryTypeIndex = selectMemoryType(memProps, indexBufMemReq.memoryTypeBits, MemoryUsage::Dynamic);
+    if (indexBufMemAllocInfo.memoryTypeIndex == UINT32_MAX) {
         std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
         return -1;
     }
@@ -207,7 +205,7 @@ int IndexBuffer::execute() {
 
     void* indexBufMem = device->mapMemory(indexBufMemory.get(), 0, sizeof(uint16_t) * indices.size());
 
-    std::memcpy(indexBufMem, indices.data(), sizeof(uint16_t) * indices.size());
+    copyToMapped(indexBufMem, indices.data(), sizeof(uint16_t) * indices.size());
 
     flushMemoryRange.memory = indexBufMemory.get();
     flushMemoryRange.offset = 0;
@@ -220,8 +218,8 @@ int IndexBuffer::execute() {
     std::vector<vk::SurfaceFormatKHR> surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
     std::vector<vk::PresentModeKHR> surfacePresentModes = physicalDevice.getSurfacePresentModesKHR(surface.get());
 
-    vk::SurfaceFormatKHR swapchainFormat = surfaceFormats[0];
-    vk::PresentModeKHR swapchainPresentMode = surfacePresentModes[0];
+    vk::SurfaceFormatKHR swapchainFormat = selectSurfaceFormat(surfaceFormats);
+    vk::PresentModeKHR swapchainPresentMode = selectPresentMode(surfacePresentModes, options.presentModePolicy);
 
     vk::AttachmentDescription attachments[1];
     attachments[0].format = swapchainFormat.format;
@@ -252,23 +250,18 @@ int IndexBuffer::execute() {
 
     vk::UniqueRenderPass renderpass = device->createRenderPassUnique(renderpassCreateInfo);
 
-    vk::Viewport viewports[1];
-    viewports[0].x = 0.0;
-    viewports[0].y = 0.0;
-    viewports[0].minDepth = 0.0;
-    viewports[0].maxDepth = 1.0;
-    viewports[0].width = screenWidth;
-    viewports[0].height = screenHeight;
-
-    vk::Rect2D scissors[1];
-    scissors[0].offset = vk::Offset2D{ 0, 0 };
-    scissors[0].extent = vk::Extent2D{ screenWidth, screenHeight };
+    // 現在のスワップチェーンのサイズ (作り直すたびに更新し、ビューポート・シザー・描画範囲に使う)
+    vk::Extent2D swapchainExtent;
 
+    // ビューポートとシザーは記録時にスワップチェーンのサイズで設定する (作り直してもパイプラインはそのまま使える)
     vk::PipelineViewportStateCreateInfo viewportState;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = viewports;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = scissors;
+
+    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.dynamicStateCount = std::size(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates;
 
     vk::VertexInputBindingDescription vertexBindingDescription[1];
     vertexBindingDescription[0].binding = 0;
@@ -363,6 +356,7 @@ int IndexBuffer::execute() {
 
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
     pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
     pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
     pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
     pipelineCreateInfo.pRasterizationState = &rasterizer;
@@ -380,29 +374,41 @@ int IndexBuffer::execute() {
     std::vector<vk::Image> swapchainImages;
     std::vector<vk::UniqueImageView> swapchainImageViews;
     std::vector<vk::UniqueFramebuffer> swapchainFramebufs;
+    // 描画完了のセマフォはプレゼンテーションが待ち終わるまで再びシグナルできないため、フレームスロットではなく画像ごとに持つ
+    //  (画像はプレゼンテーションが終わるまで再取得されない)
+    std::vector<vk::UniqueSemaphore> imgRenderedSemaphores;
 
     auto recreateSwapchain = [&](){
-        swapchainFramebufs.clear();
-        swapchainImageViews.clear();
+        // 古いスワップチェーンやフレームバッファは投入済みのフレームがまだ使っている可能性がある
+        // GPUの完了を待って止まる代わりに、投入済みの全フレームが完了するまで破棄を遅らせる
+        uint64_t retireValue = scheduler.submittedValue();
+        scheduler.destroyAfter(retireValue, std::move(swapchainFramebufs));
+        scheduler.destroyAfter(retireValue, std::move(swapchainImageViews));
+        scheduler.destroyAfter(retireValue, std::move(imgRenderedSemaphores));
         swapchainImages.clear();
-        swapchain.reset();
+
+        // 古いスワップチェーンを渡すと、ドライバは表示中の画像やメモリを新しいスワップチェーンに引き継げる
+        vk::UniqueSwapchainKHR oldSwapchain = std::move(swapchain);
 
         vk::SurfaceCapabilitiesKHR surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface.get());
+        swapchainExtent = sampleWindow.extent(surfaceCapabilities);
 
         vk::SwapchainCreateInfoKHR swapchainCreateInfo;
         swapchainCreateInfo.surface = surface.get();
         swapchainCreateInfo.minImageCount = surfaceCapabilities.minImageCount + 1;
         swapchainCreateInfo.imageFormat = swapchainFormat.format;
         swapchainCreateInfo.imageColorSpace = swapchainFormat.colorSpace;
-        swapchainCreateInfo.imageExtent = surfaceCapabilities.currentExtent;
+        swapchainCreateInfo.imageExtent = swapchainExtent;
         swapchainCreateInfo.imageArrayLayers = 1;
         swapchainCreateInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
         swapchainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
         swapchainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
         swapchainCreateInfo.presentMode = swapchainPresentMode;
         swapchainCreateInfo.clipped = VK_TRUE;
+        swapchainCreateInfo.oldSwapchain = oldSwapchain.get();
 
         swapchain = device->createSwapchainKHRUnique(swapchainCreateInfo);
+        scheduler.destroyAfter(retireValue, std::move(oldSwapchain));
 
         swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
 
@@ -426,6 +432,11 @@ int IndexBuffer::execute() {
             swapchainImageViews[i] = device->createImageViewUnique(imgViewCreateInfo);
         }
 
+        imgRenderedSemaphores.resize(swapchainImages.size());
+        for (size_t i = 0; i < swapchainImages.size(); i++) {
+            imgRenderedSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+        }
+
         swapchainFramebufs.resize(swapchainImages.size());
 
         for (size_t i = 0; i < swapchainImages.size(); i++) {
@@ -433,8 +444,8 @@ int IndexBuffer::execute() {
             frameBufAttachments[0] = swapchainImageViews[i].get();
 
             vk::FramebufferCreateInfo frameBufCreateInfo;
-            frameBufCreateInfo.width = surfaceCapabilities.currentExtent.width;
-            frameBufCreateInfo.height = surfaceCapabilities.currentExtent.height;
+            frameBufCreateInfo.width = swapchainExtent.width;
+            frameBufCreateInfo.height = swapchainExtent.height;
             frameBufCreateInfo.layers = 1;
             frameBufCreateInfo.renderPass = renderpass.get();
             frameBufCreateInfo.attachmentCount = 1;
@@ -446,52 +457,63 @@ int IndexBuffer::execute() {
 
     recreateSwapchain();
 
-    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
-    cmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    vk::UniqueCommandPool cmdPool = device->createCommandPoolUnique(cmdPoolCreateInfo);
-
-    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
-    cmdBufAllocInfo.commandPool = cmdPool.get();
-    cmdBufAllocInfo.commandBufferCount = 1;
-    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-    std::vector<vk::UniqueCommandBuffer> cmdBufs =
-        device->allocateCommandBuffersUnique(cmdBufAllocInfo);
-        
-    vk::SemaphoreCreateInfo semaphoreCreateInfo;
-
-    vk::UniqueSemaphore swapchainImgSemaphore, imgRenderedSemaphore;
-    swapchainImgSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
-    imgRenderedSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
-    
-    vk::FenceCreateInfo fenceCreateInfo;
-    fenceCreateInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-
-    vk::UniqueFence imgRenderedFence = device->createFenceUnique(fenceCreateInfo);
-
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-
-        device->waitForFences({ imgRenderedFence.get()}, VK_TRUE, UINT64_MAX);
+    // フレームスロットのリング (スロットごとにコマンドバッファとセマフォを持つ)
+    FrameRing frameRing(device.get(), scheduler, graphicsQueueFamilyIndex, options.framesInFlight);
+    FrameCounter frameCounter;
+    // 処理段階ごとのCPU時間 (終了時に分布を出力する)
+    FrameProfiler profiler;
+    // タイムスタンプクエリによるGPU時間 (--gpu-timestamps 指定時のみ)
+    GpuTimer gpuTimer(device.get(), physicalDevice, graphicsQueueFamilyIndex, options.gpuTimestamps, frameRing.size());
+    // パイプライン統計クエリ (--stats 指定時のみ)
+    PipelineStats pipelineStats(device.get(), pipelineStatsEnabled, frameRing.size());
+
+    while (!sampleWindow.shouldClose(frameCounter.count())) {
+        profiler.begin(FrameStage::PollEvents);
+        sampleWindow.pollEvents();
+        profiler.end(FrameStage::PollEvents);
+
+        // 次のフレームスロットを取得する (スロットの前回の描画が終わるまで待つ)
+        profiler.begin(FrameStage::WaitFrame);
+        FrameSlot& frame = frameRing.acquire();
+        profiler.end(FrameStage::WaitFrame);
+        // 完了したフレームに紐づく遅延処理を実行する
+        scheduler.retire();
+
+        // リサイズ負荷の計測用: 一定フレームごとに表示サイズを変えてスワップチェーンを作り直す
+        if (sampleWindow.churnResize(frameCounter.count())) {
+            recreateSwapchain();
+        }
 
-        vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, swapchainImgSemaphore.get());
-        if(acquireImgResult.result == vk::Result::eSuboptimalKHR || acquireImgResult.result == vk::Result::eErrorOutOfDateKHR) {
+        frameCounter.markAcquire();
+        vk::Result acquireResult;
+        uint32_t imgIndex = 0;
+        profiler.begin(FrameStage::Acquire);
+        try {
+            vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, frame.swapchainImgSemaphore.get());
+            acquireResult = acquireImgResult.result;
+            imgIndex = acquireImgResult.value;
+        } catch (const vk::OutOfDateKHRError&) {
+            acquireResult = vk::Result::eErrorOutOfDateKHR;
+        }
+        profiler.end(FrameStage::Acquire);
+        if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+            // 画像を取得できていないため、このフレームは描画せずに作り直す
             std::cerr << "スワップチェーンを再作成します。" << std::endl;
             recreateSwapchain();
             continue;
         }
-        if (acquireImgResult.result != vk::Result::eSuccess) {
+        if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR) {
             std::cerr << "次フレームの取得に失敗しました。" << std::endl;
             return -1;
         }
-        device->resetFences({ imgRenderedFence.get() });
-
-        uint32_t imgIndex = acquireImgResult.value;
 
-        cmdBufs[0]->reset();
+        profiler.begin(FrameStage::Record);
+        frame.cmdBuf->reset();
 
         vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBufs[0]->begin(cmdBeginInfo);
+        frame.cmdBuf->begin(cmdBeginInfo);
+        gpuTimer.beginFrame(frame.cmdBuf.get(), frameRing.currentIndex());
+        pipelineStats.beginFrame(frame.cmdBuf.get(), frameRing.currentIndex());
 
         vk::ClearValue clearVal[1];
         clearVal[0].color.float32[0] = 0.0f;
@@ -502,37 +524,48 @@ int IndexBuffer::execute() {
         vk::RenderPassBeginInfo renderpassBeginInfo;
         renderpassBeginInfo.renderPass = renderpass.get();
         renderpassBeginInfo.framebuffer = swapchainFramebufs[imgIndex].get();
-        renderpassBeginInfo.renderArea = vk::Rect2D({ 0,0 }, { screenWidth, screenHeight });
+        renderpassBeginInfo.renderArea = vk::Rect2D({0, 0}, swapchainExtent);
         renderpassBeginInfo.clearValueCount = 1;
         renderpassBeginInfo.pClearValues = clearVal;
 
-        cmdBufs[0]->beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+        uint32_t renderPassScope = gpuTimer.beginScope(frame.cmdBuf.get(), "render pass");
+        frame.cmdBuf->beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
 
-        cmdBufs[0]->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
-        cmdBufs[0]->bindVertexBuffers(0, { vertexBuf.get() }, { 0 });
-        cmdBufs[0]->bindIndexBuffer(indexBuf.get(), 0, vk::IndexType::eUint16); // インデックスバッファを使用した描画
-        cmdBufs[0]->drawIndexed(indices.size(), 1, 0, 0, 0);
+        frame.cmdBuf->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        frame.cmdBuf->setViewport(0, {vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), 0.0f, 1.0f)});
+        frame.cmdBuf->setScissor(0, {vk::Rect2D({0, 0}, swapchainExtent)});
+        frame.cmdBuf->bindVertexBuffers(0, { vertexBuf.get() }, { 0 });
+        frame.cmdBuf->bindIndexBuffer(indexBuf.get(), 0, vk::IndexType::eUint16); // インデックスバッファを使用した描画
+        uint32_t drawScope = gpuTimer.beginScope(frame.cmdBuf.get(), "draw");
+        uint32_t drawStatsScope = pipelineStats.beginScope(frame.cmdBuf.get(), "draw");
+        frame.cmdBuf->drawIndexed(indices.size(), 1, 0, 0, 0);
+        pipelineStats.endScope(frame.cmdBuf.get(), drawStatsScope);
+        gpuTimer.endScope(frame.cmdBuf.get(), drawScope);
 
-        cmdBufs[0]->endRenderPass();
+        frame.cmdBuf->endRenderPass();
+        gpuTimer.endScope(frame.cmdBuf.get(), renderPassScope);
 
-        cmdBufs[0]->end();
+        frame.cmdBuf->end();
+        profiler.end(FrameStage::Record);
 
-        vk::CommandBuffer submitCmdBuf[1] = { cmdBufs[0].get() };
+        vk::CommandBuffer submitCmdBuf[1] = { frame.cmdBuf.get() };
         vk::SubmitInfo submitInfo;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = submitCmdBuf;
 
-        vk::Semaphore renderwaitSemaphores[] = { swapchainImgSemaphore.get() };
+        vk::Semaphore renderwaitSemaphores[] = { frame.swapchainImgSemaphore.get() };
         vk::PipelineStageFlags renderwaitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = renderwaitSemaphores;
         submitInfo.pWaitDstStageMask = renderwaitStages;
 
-        vk::Semaphore renderSignalSemaphores[] = { imgRenderedSemaphore.get() };
+        vk::Semaphore renderSignalSemaphores[] = { imgRenderedSemaphores[imgIndex].get() };
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = renderSignalSemaphores;
 
-        graphicsQueue.submit({ submitInfo }, imgRenderedFence.get());
+        profiler.begin(FrameStage::Submit);
+        frame.timelineValue = scheduler.submit(graphicsQueue, submitInfo);
+        profiler.end(FrameStage::Submit);
 
         vk::PresentInfoKHR presentInfo;
 
@@ -543,14 +576,34 @@ int IndexBuffer::execute() {
         presentInfo.pSwapchains = presentSwapchains.begin();
         presentInfo.pImageIndices = imgIndices.begin();
 
-        vk::Semaphore presenWaitSemaphores[] = { imgRenderedSemaphore.get() };
+        vk::Semaphore presenWaitSemaphores[] = { imgRenderedSemaphores[imgIndex].get() };
         presentInfo.waitSemaphoreCount = 1;
         presentInfo.pWaitSemaphores = presenWaitSemaphores;
 
-        graphicsQueue.presentKHR(presentInfo);
+        // SUBOPTIMALの場合は取得済みの画像を表示してからスワップチェーンを作り直す
+        bool needsRecreate = acquireResult == vk::Result::eSuboptimalKHR;
+        profiler.begin(FrameStage::Present);
+        try {
+            needsRecreate |= graphicsQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR;
+        } catch (const vk::OutOfDateKHRError&) {
+            needsRecreate = true;
+        }
+        profiler.end(FrameStage::Present);
+
+        frameCounter.tick();
+
+        if (needsRecreate) {
+            std::cerr << "スワップチェーンを再作成します。" << std::endl;
+            recreateSwapchain();
+        }
     }
 
     graphicsQueue.waitIdle();
-    glfwTerminate();
+    // 破棄を遅らせていたオブジェクトを、参照先(コマンドプールなど)より先に破棄する
+    scheduler.retire();
+    frameCounter.report(std::cout);
+    profiler.report(std::cout);
+    gpuTimer.report(std::cout);
+    pipelineStats.report(std::cout);
     return 0;
 }
\ No newline at end of file
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "command.h"
+#include "sample_options.h"
 
 class IndexBuffer : public Command {
 public:
-    IndexBuffer() {};
+    IndexBuffer(const SampleOptions& options) : options(options) {};
     ~IndexBuffer() override {};
 
     int execute() override;
+
+private:
+    SampleOptions options;
 };
\ No newline at end of file
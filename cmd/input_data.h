@@ -1,11 +1,15 @@
 #pragma once
 
 #include "command.h"
+#include "sample_options.h"
 
 class InputData : public Command{
 public:
-    InputData() {};
+    InputData(const SampleOptions& options) : options(options) {};
     ~InputData() override {};
 
     int execute() override;
+
+private:
+    SampleOptions options;
 };
@@ -0,0 +1,170 @@
+#include "mapped_copy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MAPPED_COPY_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang ではビルド全体の命令セットを上げずに、関数ごとに使う命令セットを指定する
+#if defined(MAPPED_COPY_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MAPPED_COPY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MAPPED_COPY_TARGET(isa)
+#endif
+
+namespace {
+
+// これより小さいコピーは非テンポラルストアの効果がないため memcpy() を使う
+const size_t streamingThreshold = 256;
+
+#if defined(MAPPED_COPY_X86)
+
+bool cpuSupports(MappedCopyKernel kernel) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    // AVXのレジスタをOSが保存するか (OSXSAVE と XCR0 の SSE/AVX のビット)
+    bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (osAvx && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    switch (kernel) {
+    case MappedCopyKernel::Scalar:
+        return true;
+    case MappedCopyKernel::Sse2:
+        return sse2;
+    case MappedCopyKernel::Avx2:
+        return avx2;
+    }
+    return false;
+}
+
+// 書き込み先を alignment の境界まで通常のコピーで進める
+void copyHead(char*& d, const char*& s, size_t& size, size_t alignment) {
+    size_t head = (alignment - (reinterpret_cast<uintptr_t>(d) & (alignment - 1))) & (alignment - 1);
+    head = std::min(head, size);
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+}
+
+MAPPED_COPY_TARGET("sse2")
+void copyStreamSse2(char* d, const char* s, size_t size) {
+    copyHead(d, s, size, 16);
+    // 1キャッシュライン(64バイト)ずつ読み込んでから書き込み、ライトコンバインのバッファを埋める
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+        __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), v0);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+    }
+    for (; size >= 16; size -= 16, d += 16, s += 16) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+    }
+    std::memcpy(d, s, size);
+    // 非テンポラルストアは他の書き込みと順序付けられないため、後続のフラッシュや投入より前に完了させる
+    _mm_sfence();
+}
+
+MAPPED_COPY_TARGET("avx2")
+void copyStreamAvx2(char* d, const char* s, size_t size) {
+    copyHead(d, s, size, 32);
+    // 2キャッシュライン(128バイト)ずつ読み込んでから書き込む
+    for (; size >= 128; size -= 128, d += 128, s += 128) {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+        __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+        __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), v0);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), v1);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), v2);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), v3);
+    }
+    for (; size >= 32; size -= 32, d += 32, s += 32) {
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+    }
+    std::memcpy(d, s, size);
+    _mm_sfence();
+}
+
+#endif
+
+}
+
+MappedCopyKernel selectMappedCopyKernel() {
+    static const MappedCopyKernel kernel = []() {
+        if (isMappedCopyKernelSupported(MappedCopyKernel::Avx2)) {
+            return MappedCopyKernel::Avx2;
+        }
+        if (isMappedCopyKernelSupported(MappedCopyKernel::Sse2)) {
+            return MappedCopyKernel::Sse2;
+        }
+        return MappedCopyKernel::Scalar;
+    }();
+    return kernel;
+}
+
+bool isMappedCopyKernelSupported(MappedCopyKernel kernel) {
+#if defined(MAPPED_COPY_X86)
+    return cpuSupports(kernel);
+#else
+    return kernel == MappedCopyKernel::Scalar;
+#endif
+}
+
+const char* mappedCopyKernelName(MappedCopyKernel kernel) {
+    switch (kernel) {
+    case MappedCopyKernel::Scalar:
+        return "scalar";
+    case MappedCopyKernel::Sse2:
+        return "sse2";
+    case MappedCopyKernel::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void copyToMapped(void* dst, const void* src, size_t size) {
+    copyToMapped(selectMappedCopyKernel(), dst, src, size);
+}
+
+void copyToMapped(MappedCopyKernel kernel, void* dst, const void* src, size_t size) {
+    if (size < streamingThreshold) {
+        kernel = MappedCopyKernel::Scalar;
+    }
+    switch (kernel) {
+#if defined(MAPPED_COPY_X86)
+    case MappedCopyKernel::Sse2:
+        copyStreamSse2(static_cast<char*>(dst), static_cast<const char*>(src), size);
+        return;
+    case MappedCopyKernel::Avx2:
+        copyStreamAvx2(static_cast<char*>(dst), static_cast<const char*>(src), size);
+        return;
+#endif
+    default:
+        std::memcpy(dst, src, size);
+        return;
+    }
+}
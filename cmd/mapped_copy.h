@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// マップしたVulkanのメモリへの書き込みに使うコピー
+//  ホスト可視のデバイスメモリはライトコンバインのことが多く、通常の memcpy() ではキャッシュラインの読み込みや
+//  部分的な書き込みで遅くなる上、再び読まないデータでCPUのキャッシュを汚す。
+//  x86では非テンポラルストア(AVX2 / SSE2)でキャッシュを経由せずに書き込み、使うカーネルは実行時のCPUで選ぶ。
+//  それ以外のCPUと小さなコピーでは memcpy() を使う。
+
+enum class MappedCopyKernel {
+    Scalar,  // memcpy()
+    Sse2,    // 16バイトの非テンポラルストア
+    Avx2,    // 32バイトの非テンポラルストア
+};
+
+// 実行中のCPUで使えるもっとも速いカーネル (初回の呼び出し時に判定する)
+MappedCopyKernel selectMappedCopyKernel();
+
+// 実行中のCPUで kernel が使えるか
+bool isMappedCopyKernelSupported(MappedCopyKernel kernel);
+
+const char* mappedCopyKernelName(MappedCopyKernel kernel);
+
+// src から size バイトをマップしたメモリ dst へコピーする
+//  非テンポラルストアの完了はコピーの最後で待つため、戻った後のフラッシュや投入の順序は通常の書き込みと変わらない
+void copyToMapped(void* dst, const void* src, size_t size);
+
+// 指定したカーネルでコピーする (ベンチマーク用。isMappedCopyKernelSupported() が false のカーネルは指定しないこと)
+void copyToMapped(MappedCopyKernel kernel, void* dst, const void* src, size_t size);
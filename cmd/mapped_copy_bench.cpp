@@ -0,0 +1,100 @@
+#include "mapped_copy_bench.h"
+#include "bench_context.h"
+#include "device_allocator.h"
+#include "mapped_copy.h"
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// サイズごとに、この量を書き込むまでコピーを繰り返す
+const vk::DeviceSize bytesPerMeasurement = 1024ull * 1024 * 1024;
+
+}
+
+int MappedCopyBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+    const vk::PhysicalDeviceMemoryProperties& memProps = allocator.memoryProperties();
+
+    // 最大のコピーサイズ (MiB)
+    vk::DeviceSize maxSize = vk::DeviceSize(options.count > 0 ? options.count : 64) * 1024 * 1024;
+    std::vector<vk::DeviceSize> sizes;
+    for (vk::DeviceSize size = 4 * 1024; size < maxSize; size *= 16) {
+        sizes.push_back(size);
+    }
+    sizes.push_back(maxSize);
+
+    std::vector<MappedCopyKernel> kernels;
+    for (MappedCopyKernel kernel : {MappedCopyKernel::Scalar, MappedCopyKernel::Sse2, MappedCopyKernel::Avx2}) {
+        if (isMappedCopyKernelSupported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    std::cout << "selected kernel: " << mappedCopyKernelName(selectMappedCopyKernel()) << std::endl;
+
+    std::vector<char> hostData(maxSize, 0x5a);
+
+    for (MemoryUsage usage : {MemoryUsage::Upload, MemoryUsage::Dynamic}) {
+        vk::BufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.size = maxSize;
+        bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eVertexBuffer;
+        bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+        vk::UniqueBuffer buffer = device.createBufferUnique(bufferCreateInfo);
+
+        vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffer.get());
+        uint32_t memTypeIndex = selectMemoryType(memProps, memReq.memoryTypeBits, usage);
+        std::cout << memoryUsageName(usage) << ": ";
+        if (memTypeIndex == UINT32_MAX) {
+            std::cout << "no suitable memory type" << std::endl;
+            continue;
+        }
+        std::cout << "type " << memTypeIndex << " (" << memoryPropertyString(memProps.memoryTypes[memTypeIndex].propertyFlags) << ")" << std::endl;
+
+        DeviceAllocation allocation = allocator.allocateForBuffer(buffer.get(), memTypeIndex, usage);
+        if (!allocation.mapped()) {
+            continue;
+        }
+
+        for (vk::DeviceSize size : sizes) {
+            uint64_t repeat = std::max<uint64_t>(bytesPerMeasurement / size, 1);
+            std::cout << "\t" << size / 1024 << " KiB:";
+
+            double scalarGBps = 0.0;
+            for (MappedCopyKernel kernel : kernels) {
+                // 1回目はページフォールトなどを含むため計測しない
+                copyToMapped(kernel, allocation.mapped(), hostData.data(), size);
+
+                Clock::time_point start = Clock::now();
+                for (uint64_t i = 0; i < repeat; i++) {
+                    copyToMapped(kernel, allocation.mapped(), hostData.data(), size);
+                }
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                double gbps = seconds > 0.0 ? size * repeat / seconds / 1e9 : 0.0;
+                if (kernel == MappedCopyKernel::Scalar) {
+                    scalarGBps = gbps;
+                }
+
+                std::cout << " " << (kernel == MappedCopyKernel::Scalar ? "memcpy" : mappedCopyKernelName(kernel)) << " " << gbps << " GB/s";
+                if (kernel != MappedCopyKernel::Scalar && scalarGBps > 0.0) {
+                    std::cout << " (" << gbps / scalarGBps << "x)";
+                }
+            }
+            std::cout << std::endl;
+        }
+        allocation.flush();
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// マップしたメモリ(アップロード用と毎フレーム更新用のメモリタイプ)への書き込みについて、memcpy() と
+// 非テンポラルストアのコピー (SSE2, AVX2) の速度をサイズごとに比較するベンチマーク
+class MappedCopyBench : public Command {
+public:
+    MappedCopyBench(const BenchOptions& options) : options(options) {};
+    ~MappedCopyBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
@@ -0,0 +1,144 @@
+#include "memory_bandwidth_bench.h"
+#include "bench_context.h"
+#include "device_allocator.h"
+#include "mapped_copy.h"
+#include "memory_type.h"
+
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 計測を繰り返す回数
+const int iterations = 8;
+
+double gigabytesPerSecond(vk::DeviceSize bytes, Clock::time_point start) {
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0;
+}
+
+// 単体のGPU (RADV・ANVのように性質なしのメモリタイプがない構成) を模したメモリプロパティで、
+// デバイスローカルのヒープが予算に近い時の逃げ先がシステムメモリになることを確かめる
+bool checkFallbackSelection() {
+    using Flag = vk::MemoryPropertyFlagBits;
+
+    vk::PhysicalDeviceMemoryProperties memProps;
+    memProps.memoryHeapCount = 3;
+    memProps.memoryHeaps[0] = vk::MemoryHeap(8ull << 30, vk::MemoryHeapFlagBits::eDeviceLocal);    // VRAM
+    memProps.memoryHeaps[1] = vk::MemoryHeap(16ull << 30, {});                                     // システムメモリ
+    memProps.memoryHeaps[2] = vk::MemoryHeap(256ull << 20, vk::MemoryHeapFlagBits::eDeviceLocal);  // BAR
+    memProps.memoryTypeCount = 4;
+    memProps.memoryTypes[0] = vk::MemoryType(Flag::eDeviceLocal, 0);
+    memProps.memoryTypes[1] = vk::MemoryType(Flag::eHostVisible | Flag::eHostCoherent, 1);
+    memProps.memoryTypes[2] = vk::MemoryType(Flag::eDeviceLocal | Flag::eHostVisible | Flag::eHostCoherent, 2);
+    memProps.memoryTypes[3] = vk::MemoryType(Flag::eHostVisible | Flag::eHostCoherent | Flag::eHostCached, 1);
+
+    struct Case {
+        MemoryUsage usage;
+        uint32_t exhaustedHeap;
+        uint32_t expectedType;
+    };
+    const Case cases[] = {
+        {MemoryUsage::GpuOnly, 0, 1},   // VRAMが足りなければBARではなくシステムメモリへ
+        {MemoryUsage::Dynamic, 2, 1},   // BARが足りなければシステムメモリへ
+        {MemoryUsage::Readback, 0, 3},  // リードバックはキャッシュ付きのまま
+    };
+
+    bool passed = true;
+    for (const Case& c : cases) {
+        uint32_t candidateBits = 0;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            if (memProps.memoryTypes[i].heapIndex != c.exhaustedHeap) {
+                candidateBits |= 1 << i;
+            }
+        }
+        uint32_t typeIndex = selectFallbackMemoryType(memProps, candidateBits, c.usage);
+        if (typeIndex != c.expectedType) {
+            std::cerr << "fallback for " << memoryUsageName(c.usage) << " (heap " << c.exhaustedHeap << " near budget): expected type "
+                      << c.expectedType << ", got " << static_cast<int>(typeIndex) << std::endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+}
+
+int MemoryBandwidthBench::execute() {
+    if (!checkFallbackSelection()) {
+        return -1;
+    }
+    std::cout << "fallback selection check: ok" << std::endl;
+
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+    const vk::PhysicalDeviceMemoryProperties& memProps = allocator.memoryProperties();
+
+    // 計測に使うバッファのサイズ (MiB)
+    vk::DeviceSize bufferSize = vk::DeviceSize(options.count > 0 ? options.count : 64) * 1024 * 1024;
+
+    std::cout << "memory types:" << std::endl;
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+        uint32_t heapIndex = memProps.memoryTypes[i].heapIndex;
+        std::cout << "\t" << i << ": " << memoryPropertyString(memProps.memoryTypes[i].propertyFlags)
+                  << " (heap " << heapIndex << ", " << memProps.memoryHeaps[heapIndex].size / (1024 * 1024) << " MiB)" << std::endl;
+    }
+
+    std::vector<uint8_t> hostData(bufferSize, 0x5a);
+    std::vector<uint8_t> readData(bufferSize);
+
+    for (MemoryUsage usage : {MemoryUsage::GpuOnly, MemoryUsage::Upload, MemoryUsage::Readback, MemoryUsage::Dynamic}) {
+        vk::BufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.size = bufferSize;
+        bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer;
+        bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+        vk::UniqueBuffer buffer = device.createBufferUnique(bufferCreateInfo);
+
+        vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffer.get());
+        uint32_t memTypeIndex = selectMemoryType(memProps, memReq.memoryTypeBits, usage);
+
+        std::cout << memoryUsageName(usage) << ": ";
+        if (memTypeIndex == UINT32_MAX) {
+            std::cout << "no suitable memory type" << std::endl;
+            continue;
+        }
+        std::cout << "type " << memTypeIndex << " (" << memoryPropertyString(memProps.memoryTypes[memTypeIndex].propertyFlags) << ")";
+
+        DeviceAllocation allocation = allocator.allocateForBuffer(buffer.get(), memTypeIndex, usage);
+        if (!allocation.mapped()) {
+            // ホストから参照できないため帯域は計測しない
+            std::cout << std::endl;
+            continue;
+        }
+
+        // アップロード: ホストのデータをマップしたメモリへ書き込み、デバイスへ反映させる
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < iterations; i++) {
+            copyToMapped(allocation.mapped(), hostData.data(), bufferSize);
+            allocation.flush();
+        }
+        double uploadGBps = gigabytesPerSecond(bufferSize * iterations, start);
+
+        // リードバック: デバイスの書き込みをホストへ反映させ、マップしたメモリから読み出す
+        start = Clock::now();
+        for (int i = 0; i < iterations; i++) {
+            allocation.invalidate();
+            std::memcpy(readData.data(), allocation.mapped(), bufferSize);
+        }
+        double readbackGBps = gigabytesPerSecond(bufferSize * iterations, start);
+
+        std::cout << ", upload " << uploadGBps << " GB/s, readback " << readbackGBps << " GB/s"
+                  << " (check: " << static_cast<int>(readData[bufferSize - 1]) << ")" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// 用途ごとに選んだメモリタイプについて、ホストからの書き込み(アップロード)と
+// 読み出し(リードバック)の帯域を計測するベンチマーク
+class MemoryBandwidthBench : public Command {
+public:
+    MemoryBandwidthBench(const BenchOptions& options) : options(options) {};
+    ~MemoryBandwidthBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
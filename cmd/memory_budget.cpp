@@ -0,0 +1,98 @@
+#include "memory_budget.h"
+
+#include <iostream>
+#include <string_view>
+
+bool MemoryBudget::isSupported(vk::PhysicalDevice physicalDevice) {
+    std::vector<vk::ExtensionProperties> extProps = physicalDevice.enumerateDeviceExtensionProperties();
+    for (size_t i = 0; i < extProps.size(); i++) {
+        if (std::string_view(extProps[i].extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MemoryBudget::MemoryBudget(vk::PhysicalDevice physicalDevice, bool extensionEnabled)
+    : physicalDevice(physicalDevice),
+      extensionEnabled(extensionEnabled),
+      memProps(physicalDevice.getMemoryProperties()) {
+    heapBudget.resize(memProps.memoryHeapCount, 0);
+    heapUsage.resize(memProps.memoryHeapCount, 0);
+    allocatedDelta.resize(memProps.memoryHeapCount, 0);
+    freedDelta.resize(memProps.memoryHeapCount, 0);
+    warned.resize(memProps.memoryHeapCount, false);
+
+    if (!extensionEnabled) {
+        std::cout << "VK_EXT_memory_budget が使えないため、ヒープサイズの80%を予算として扱います。" << std::endl;
+    }
+    update();
+}
+
+void MemoryBudget::update() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (extensionEnabled) {
+        auto props = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budgetProps = props.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+            heapBudget[i] = budgetProps.heapBudget[i];
+            heapUsage[i] = budgetProps.heapUsage[i];
+            // ドライバの値にはここまでの確保・解放が反映済み
+            allocatedDelta[i] = 0;
+            freedDelta[i] = 0;
+        }
+    } else {
+        for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+            heapBudget[i] = memProps.memoryHeaps[i].size / 10 * 8;
+            heapUsage[i] = heapUsage[i] + allocatedDelta[i] - freedDelta[i];
+            allocatedDelta[i] = 0;
+            freedDelta[i] = 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+        bool over = heapUsage[i] > heapBudget[i] * warnRatio;
+        if (over && !warned[i]) {
+            std::cerr << "警告: ヒープ" << i << "の使用量 (" << heapUsage[i] / (1024 * 1024) << " MiB) が予算 ("
+                      << heapBudget[i] / (1024 * 1024) << " MiB) に近づいています。" << std::endl;
+        }
+        warned[i] = over;
+    }
+}
+
+void MemoryBudget::notifyAllocated(uint32_t heapIndex, vk::DeviceSize size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    allocatedDelta[heapIndex] += size;
+}
+
+void MemoryBudget::notifyFreed(uint32_t heapIndex, vk::DeviceSize size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freedDelta[heapIndex] += size;
+}
+
+bool MemoryBudget::hasRoom(uint32_t heapIndex, vk::DeviceSize size) const {
+    return usage(heapIndex) + size <= budget(heapIndex) * warnRatio;
+}
+
+vk::DeviceSize MemoryBudget::budget(uint32_t heapIndex) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return heapBudget[heapIndex];
+}
+
+vk::DeviceSize MemoryBudget::usage(uint32_t heapIndex) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    vk::DeviceSize usage = heapUsage[heapIndex] + allocatedDelta[heapIndex];
+    return usage > freedDelta[heapIndex] ? usage - freedDelta[heapIndex] : 0;
+}
+
+void MemoryBudget::report(std::ostream& os) const {
+    os << "memory budget" << (extensionEnabled ? "" : " (estimated)") << ":" << std::endl;
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+        vk::DeviceSize heapBudgetBytes = budget(i);
+        vk::DeviceSize heapUsageBytes = usage(i);
+        os << "\theap " << i << (memProps.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal ? " (device local)" : "")
+           << ": usage " << heapUsageBytes / (1024 * 1024) << " MiB / budget " << heapBudgetBytes / (1024 * 1024) << " MiB"
+           << " (" << (heapBudgetBytes > 0 ? heapUsageBytes * 100.0 / heapBudgetBytes : 0.0) << "%)" << std::endl;
+    }
+}
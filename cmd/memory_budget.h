@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// ヒープごとのメモリの予算(このプロセスが使ってよい量の目安)と使用量
+//  VK_EXT_memory_budget が有効なら driver が報告する値を使う。
+//  無効な場合はヒープサイズの80%を予算とし、このアプリが確保した量を使用量とする。
+//  値の取得はドライバ呼び出しになるため update() で行い、その間の確保・解放は notifyAllocated() などで加算する。
+class MemoryBudget {
+public:
+    // VK_EXT_memory_budget に対応しているか
+    static bool isSupported(vk::PhysicalDevice physicalDevice);
+
+    // extensionEnabled にはデバイス作成時に VK_EXT_memory_budget を有効にしたかを指定する
+    MemoryBudget(vk::PhysicalDevice physicalDevice, bool extensionEnabled);
+
+    // 予算と使用量を取得し直す。使用量が予算の warnRatio を超えたヒープがあれば警告を出力する
+    void update();
+
+    // アロケータが vk::DeviceMemory を確保・解放した時に呼ぶ
+    void notifyAllocated(uint32_t heapIndex, vk::DeviceSize size);
+    void notifyFreed(uint32_t heapIndex, vk::DeviceSize size);
+
+    // size バイトを追加で確保しても予算の warnRatio 以内に収まるか
+    bool hasRoom(uint32_t heapIndex, vk::DeviceSize size) const;
+
+    vk::DeviceSize budget(uint32_t heapIndex) const;
+    vk::DeviceSize usage(uint32_t heapIndex) const;
+
+    // ヒープごとの予算と使用量を出力する
+    void report(std::ostream& os) const;
+
+    // 警告・フォールバックを始める使用率
+    static constexpr double warnRatio = 0.9;
+
+private:
+    vk::PhysicalDevice physicalDevice;
+    bool extensionEnabled;
+    vk::PhysicalDeviceMemoryProperties memProps;
+
+    mutable std::mutex mutex;
+    std::vector<vk::DeviceSize> heapBudget;
+    std::vector<vk::DeviceSize> heapUsage;       // update() 時点の使用量
+    std::vector<vk::DeviceSize> allocatedDelta;  // update() 以降に確保した量
+    std::vector<vk::DeviceSize> freedDelta;      // update() 以降に解放した量
+    std::vector<bool> warned;
+};
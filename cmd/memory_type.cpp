@@ -0,0 +1,174 @@
+#include "memory_type.h"
+
+const char* memoryUsageName(MemoryUsage usage) {
+    switch (usage) {
+    case MemoryUsage::GpuOnly: return "gpu only";
+    case MemoryUsage::Upload: return "upload";
+    case MemoryUsage::Readback: return "readback";
+    case MemoryUsage::Dynamic: return "dynamic";
+    default: return "unknown";
+    }
+}
+
+namespace {
+
+// 用途に使えないメモリタイプは負の値を返す
+int scoreMemoryType(vk::MemoryPropertyFlags flags, MemoryUsage usage, bool unifiedMemory) {
+    using Flag = vk::MemoryPropertyFlagBits;
+
+    // 遅延確保(タイル型GPUのトランジェントアタッチメント用)と保護メモリは汎用の用途に使わない
+    if (flags & (Flag::eLazilyAllocated | Flag::eProtected)) {
+        return -1;
+    }
+
+    bool deviceLocal = static_cast<bool>(flags & Flag::eDeviceLocal);
+    bool hostVisible = static_cast<bool>(flags & Flag::eHostVisible);
+    bool hostCoherent = static_cast<bool>(flags & Flag::eHostCoherent);
+    bool hostCached = static_cast<bool>(flags & Flag::eHostCached);
+
+    if (usage != MemoryUsage::GpuOnly && !hostVisible) {
+        return -1;
+    }
+
+    int score = 0;
+    switch (usage) {
+    case MemoryUsage::GpuOnly:
+        score += deviceLocal ? 100 : 0;
+        if (unifiedMemory) {
+            // UMAではどのメモリも同じ物理メモリのため、ホストから直接書き込めるメモリを選ぶ
+            score += hostVisible ? 10 : 0;
+            // GPUから読む時にCPUのキャッシュとの一貫性を保つ分だけ遅くなることがある
+            score -= hostCached ? 5 : 0;
+        } else {
+            // ホスト可視のデバイスローカルメモリは小さいことが多いため、ホストから触らないリソースには使わない
+            score -= hostVisible ? 10 : 0;
+        }
+        break;
+    case MemoryUsage::Upload:
+        score += hostCoherent ? 20 : 0;
+        score -= deviceLocal ? 10 : 0;
+        // 書き込みのみのためキャッシュは不要 (書き込み結合の方が速い)
+        score -= hostCached ? 5 : 0;
+        break;
+    case MemoryUsage::Readback:
+        score += hostCached ? 100 : 0;
+        score += hostCoherent ? 10 : 0;
+        score -= deviceLocal ? 10 : 0;
+        break;
+    case MemoryUsage::Dynamic:
+        score += deviceLocal ? 100 : 0;
+        score += hostCoherent ? 20 : 0;
+        score -= hostCached ? 5 : 0;
+        break;
+    }
+    return score;
+}
+
+// 予算に近いヒープの代わりとして使えないメモリタイプは負の値を返す
+int scoreFallbackMemoryType(vk::MemoryPropertyFlags flags, MemoryUsage usage) {
+    using Flag = vk::MemoryPropertyFlagBits;
+
+    if (flags & (Flag::eLazilyAllocated | Flag::eProtected)) {
+        return -1;
+    }
+
+    bool deviceLocal = static_cast<bool>(flags & Flag::eDeviceLocal);
+    bool hostVisible = static_cast<bool>(flags & Flag::eHostVisible);
+    bool hostCoherent = static_cast<bool>(flags & Flag::eHostCoherent);
+    bool hostCached = static_cast<bool>(flags & Flag::eHostCached);
+
+    if (usage != MemoryUsage::GpuOnly && !hostVisible) {
+        return -1;
+    }
+
+    // GpuOnly でもホスト可視のシステムメモリを候補にする (遅くなるが予算を超えるよりはよい)
+    //  BAR (デバイスローカルかつホスト可視) は小さくすぐに予算に達するため、最後の候補にする
+    int score = 0;
+    score += deviceLocal && hostVisible ? 0 : 100;
+    score += deviceLocal ? 20 : 0;
+    switch (usage) {
+    case MemoryUsage::GpuOnly:
+        score -= hostCached ? 5 : 0;
+        break;
+    case MemoryUsage::Upload:
+    case MemoryUsage::Dynamic:
+        score += hostCoherent ? 10 : 0;
+        score -= hostCached ? 5 : 0;
+        break;
+    case MemoryUsage::Readback:
+        score += hostCached ? 10 : 0;
+        score += hostCoherent ? 5 : 0;
+        break;
+    }
+    return score;
+}
+
+// memoryTypeBits のうち score が最も高いメモリタイプを選ぶ (同じならヒープの大きい方)
+template <typename Score>
+uint32_t selectBestMemoryType(const vk::PhysicalDeviceMemoryProperties& memProps, uint32_t memoryTypeBits, Score score) {
+    uint32_t bestIndex = UINT32_MAX;
+    int bestScore = -1;
+    vk::DeviceSize bestHeapSize = 0;
+
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+        if (!(memoryTypeBits & (1 << i))) {
+            continue;
+        }
+
+        int typeScore = score(memProps.memoryTypes[i].propertyFlags);
+        if (typeScore < 0) {
+            continue;
+        }
+
+        vk::DeviceSize heapSize = memProps.memoryHeaps[memProps.memoryTypes[i].heapIndex].size;
+        if (typeScore > bestScore || (typeScore == bestScore && heapSize > bestHeapSize)) {
+            bestIndex = i;
+            bestScore = typeScore;
+            bestHeapSize = heapSize;
+        }
+    }
+    return bestIndex;
+}
+
+}
+
+uint32_t selectMemoryType(const vk::PhysicalDeviceMemoryProperties& memProps, uint32_t memoryTypeBits, MemoryUsage usage) {
+    bool unifiedMemory = isUnifiedMemory(memProps);
+    return selectBestMemoryType(memProps, memoryTypeBits, [&](vk::MemoryPropertyFlags flags) {
+        return scoreMemoryType(flags, usage, unifiedMemory);
+    });
+}
+
+uint32_t selectFallbackMemoryType(const vk::PhysicalDeviceMemoryProperties& memProps, uint32_t memoryTypeBits, MemoryUsage usage) {
+    return selectBestMemoryType(memProps, memoryTypeBits, [&](vk::MemoryPropertyFlags flags) {
+        return scoreFallbackMemoryType(flags, usage);
+    });
+}
+
+bool isUnifiedMemory(const vk::PhysicalDeviceMemoryProperties& memProps) {
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+        if (!(memProps.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)) {
+            return false;
+        }
+    }
+    return memProps.memoryHeapCount > 0;
+}
+
+std::string memoryPropertyString(vk::MemoryPropertyFlags flags) {
+    using Flag = vk::MemoryPropertyFlagBits;
+
+    std::string str;
+    auto append = [&](Flag flag, const char* name) {
+        if (flags & flag) {
+            str += str.empty() ? "" : "|";
+            str += name;
+        }
+    };
+    append(Flag::eDeviceLocal, "DeviceLocal");
+    append(Flag::eHostVisible, "HostVisible");
+    append(Flag::eHostCoherent, "HostCoherent");
+    append(Flag::eHostCached, "HostCached");
+    append(Flag::eLazilyAllocated, "LazilyAllocated");
+    append(Flag::eProtected, "Protected");
+    return str.empty() ? "None" : str;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <string>
+
+// メモリの使い方 (メモリタイプの選択基準)
+enum class MemoryUsage {
+    GpuOnly,   // GPUだけが読み書きする (頂点バッファ、テクスチャ、レンダーターゲットなど)
+    Upload,    // CPUが一度書き込み、GPUへコピーする (ステージングバッファ)
+    Readback,  // GPUが書き込み、CPUが読み出す (画像の読み戻しなど)
+    Dynamic,   // CPUが毎フレーム書き込み、GPUが直接読む (頂点・ユニフォームのストリーミング)
+};
+
+const char* memoryUsageName(MemoryUsage usage);
+
+// memoryTypeBits で許可されたメモリタイプを用途ごとに点数付けし、最も適したものを選ぶ
+//  - Readback はホストキャッシュ付きのメモリを優先する (キャッシュなしのメモリからの読み出しは非常に遅い)
+//  - Dynamic はデバイスローカルかつホスト可視のメモリ (BAR) を優先する
+//  - Upload は小さいことの多いBARを空けておくため、デバイスローカルでないホスト可視メモリを優先する
+//  - UMA (isUnifiedMemory()) では GpuOnly もホスト可視のメモリを優先し、アップロードでステージングを省けるようにする
+//  - 点数が同じならヒープの大きい方を選ぶ
+//  条件を満たすメモリタイプがない場合はUINT32_MAXを返す
+uint32_t selectMemoryType(const vk::PhysicalDeviceMemoryProperties& memProps, uint32_t memoryTypeBits, MemoryUsage usage);
+
+// ヒープが予算に近い時の逃げ先を、そのヒープのメモリタイプを除いた memoryTypeBits から選ぶ
+//  selectMemoryType() と違い GpuOnly でもホスト可視のシステムメモリを選び、小さいBARは最後の候補にする
+//  Upload・Readback・Dynamic はホスト可視のメモリに限り、用途に合ったキャッシュ・コヒーレントの性質を優先する
+uint32_t selectFallbackMemoryType(const vk::PhysicalDeviceMemoryProperties& memProps, uint32_t memoryTypeBits, MemoryUsage usage);
+
+// すべてのヒープがデバイスローカルか (統合GPUやCPU実装のドライバのように、GPUとCPUが同じメモリを使う)
+bool isUnifiedMemory(const vk::PhysicalDeviceMemoryProperties& memProps);
+
+// メモリタイプのプロパティを "DeviceLocal|HostVisible" のような文字列にする
+std::string memoryPropertyString(vk::MemoryPropertyFlags flags);
@@ -0,0 +1,108 @@
+#include "pipeline_stats.h"
+
+bool PipelineStats::isSupported(vk::PhysicalDevice physicalDevice) {
+    return physicalDevice.getFeatures().pipelineStatisticsQuery;
+}
+
+PipelineStats::PipelineStats(vk::Device device, bool enabled, uint32_t slotCount, uint32_t maxScopesPerSlot)
+    : device(device),
+      enabled(enabled),
+      maxScopes(maxScopesPerSlot),
+      currentSlot(nullptr) {
+    if (!enabled) {
+        return;
+    }
+
+    vk::QueryPoolCreateInfo queryPoolCreateInfo;
+    queryPoolCreateInfo.queryType = vk::QueryType::ePipelineStatistics;
+    queryPoolCreateInfo.queryCount = maxScopes;
+    queryPoolCreateInfo.pipelineStatistics = statisticFlags;
+
+    slots.resize(slotCount);
+    for (Slot& slot : slots) {
+        slot.queryPool = device.createQueryPoolUnique(queryPoolCreateInfo);
+    }
+}
+
+void PipelineStats::beginFrame(vk::CommandBuffer cmdBuf, uint32_t slotIndex) {
+    if (!enabled) {
+        return;
+    }
+
+    currentSlot = &slots[slotIndex];
+    collect(*currentSlot);
+
+    cmdBuf.resetQueryPool(currentSlot->queryPool.get(), 0, maxScopes);
+}
+
+uint32_t PipelineStats::beginScope(vk::CommandBuffer cmdBuf, const char* name) {
+    if (!enabled || !currentSlot || currentSlot->scopeNames.size() >= maxScopes) {
+        return UINT32_MAX;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(currentSlot->scopeNames.size());
+    currentSlot->scopeNames.push_back(name);
+
+    cmdBuf.beginQuery(currentSlot->queryPool.get(), scope, {});
+    return scope;
+}
+
+void PipelineStats::endScope(vk::CommandBuffer cmdBuf, uint32_t scope) {
+    if (!enabled || !currentSlot || scope == UINT32_MAX) {
+        return;
+    }
+
+    cmdBuf.endQuery(currentSlot->queryPool.get(), scope);
+}
+
+void PipelineStats::collect(Slot& slot) {
+    if (slot.scopeNames.empty()) {
+        return;
+    }
+
+    // スロットの前回の投入分は完了しているため待たずに読み出せる
+    uint32_t queryCount = static_cast<uint32_t>(slot.scopeNames.size());
+    std::vector<uint64_t> results(queryCount * CounterCount);
+    vk::Result result = device.getQueryPoolResults(slot.queryPool.get(), 0, queryCount,
+        results.size() * sizeof(uint64_t), results.data(), CounterCount * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    if (result == vk::Result::eSuccess) {
+        for (size_t i = 0; i < slot.scopeNames.size(); i++) {
+            Totals& totals = scopeTotals[slot.scopeNames[i]];
+            for (size_t c = 0; c < CounterCount; c++) {
+                totals.counters[c] += results[i * CounterCount + c];
+            }
+            totals.scopes++;
+        }
+    }
+
+    slot.scopeNames.clear();
+}
+
+void PipelineStats::report(std::ostream& os) const {
+    if (!enabled) {
+        return;
+    }
+
+    os << "pipeline statistics (average per scope):" << std::endl;
+    for (const auto& [name, totals] : scopeTotals) {
+        auto average = [&](Counter counter) {
+            return static_cast<double>(totals.counters[counter]) / totals.scopes;
+        };
+        os << "\t" << name << " (" << totals.scopes << " samples):" << std::endl;
+        os << "\t\tinput assembly vertices: " << average(InputAssemblyVertices) << std::endl;
+        os << "\t\tinput assembly primitives: " << average(InputAssemblyPrimitives) << std::endl;
+        os << "\t\tvertex shader invocations: " << average(VertexShaderInvocations) << std::endl;
+        os << "\t\tclipping invocations: " << average(ClippingInvocations) << std::endl;
+        os << "\t\tclipping primitives: " << average(ClippingPrimitives) << std::endl;
+        os << "\t\tfragment shader invocations: " << average(FragmentShaderInvocations) << std::endl;
+
+        // インデックス付き描画では入力頂点数はインデックス数になるため、
+        // 1未満なら変換後頂点キャッシュで頂点シェーダーの実行が再利用されている
+        if (totals.counters[InputAssemblyVertices] > 0) {
+            os << "\t\tvertex shader invocations per input vertex (per index for indexed draws): "
+               << static_cast<double>(totals.counters[VertexShaderInvocations]) / totals.counters[InputAssemblyVertices]
+               << std::endl;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// パイプライン統計クエリによる描画ごとのパイプライン各段の処理数の計測
+//  GpuTimer と同様にフレームスロットごとにクエリプールを持ち、スロットが再利用される時に結果を読み戻す
+//  デバイス作成時に pipelineStatisticsQuery 機能を有効にしておく必要がある
+class PipelineStats {
+public:
+    // pipelineStatisticsQuery 機能に対応しているか
+    static bool isSupported(vk::PhysicalDevice physicalDevice);
+
+    PipelineStats(vk::Device device, bool enabled, uint32_t slotCount, uint32_t maxScopesPerSlot = 64);
+
+    bool isEnabled() const { return enabled; }
+
+    // コマンド記録の先頭(レンダーパスの外)で呼ぶ
+    //  スロットの前回の結果を集計し、クエリをリセットするコマンドを記録する
+    void beginFrame(vk::CommandBuffer cmdBuf, uint32_t slotIndex);
+
+    // 計測区間を開始・終了する。区間はサブパスをまたげない。区間数が上限を超えた場合は計測しない
+    uint32_t beginScope(vk::CommandBuffer cmdBuf, const char* name);
+    void endScope(vk::CommandBuffer cmdBuf, uint32_t scope);
+
+    // 区間名ごとの1区間あたりの平均値を出力する
+    void report(std::ostream& os) const;
+
+private:
+    // 取得する統計値 (結果はフラグのビット順に並ぶ)
+    enum Counter {
+        InputAssemblyVertices,
+        InputAssemblyPrimitives,
+        VertexShaderInvocations,
+        ClippingInvocations,
+        ClippingPrimitives,
+        FragmentShaderInvocations,
+        CounterCount
+    };
+    static constexpr vk::QueryPipelineStatisticFlags statisticFlags =
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+    struct Slot {
+        vk::UniqueQueryPool queryPool;
+        std::vector<std::string> scopeNames; // 前回記録した区間 (区間i → クエリi)
+    };
+
+    struct Totals {
+        std::array<uint64_t, CounterCount> counters = {};
+        uint64_t scopes = 0;
+    };
+
+    void collect(Slot& slot);
+
+    vk::Device device;
+    bool enabled;
+    uint32_t maxScopes;
+
+    std::vector<Slot> slots;
+    Slot* currentSlot;
+
+    std::map<std::string, Totals> scopeTotals;
+};
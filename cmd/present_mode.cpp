@@ -0,0 +1,73 @@
+#include "present_mode.h"
+
+#include <algorithm>
+#include <iostream>
+
+bool parsePresentModePolicy(const std::string& name, PresentModePolicy& policy) {
+    if (name == "fifo") {
+        policy = PresentModePolicy::Fifo;
+    } else if (name == "mailbox") {
+        policy = PresentModePolicy::Mailbox;
+    } else if (name == "immediate") {
+        policy = PresentModePolicy::Immediate;
+    } else if (name == "auto") {
+        policy = PresentModePolicy::AutoLowestLatency;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+vk::PresentModeKHR selectPresentMode(const std::vector<vk::PresentModeKHR>& availableModes, PresentModePolicy policy) {
+    // 方針ごとの優先順位 (先頭ほど優先)。FIFOは仕様上必ずサポートされるため最後の砦になる
+    std::vector<vk::PresentModeKHR> candidates;
+    switch (policy) {
+    case PresentModePolicy::Fifo:
+        candidates = { vk::PresentModeKHR::eFifo };
+        break;
+    case PresentModePolicy::Mailbox:
+        candidates = { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+        break;
+    case PresentModePolicy::Immediate:
+        candidates = { vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+        break;
+    case PresentModePolicy::AutoLowestLatency:
+        // MAILBOXはティアリングなしで待ち時間が最大1フレーム。なければ垂直同期のFIFOにする
+        //  IMMEDIATEとFIFO_RELAXEDはティアリングが起きるため選ばない
+        candidates = { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+        break;
+    }
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (std::find(availableModes.begin(), availableModes.end(), candidates[i]) == availableModes.end()) {
+            continue;
+        }
+        if (i > 0 && policy != PresentModePolicy::AutoLowestLatency) {
+            std::cerr << vk::to_string(candidates[0]) << " は非対応のため "
+                      << vk::to_string(candidates[i]) << " にフォールバックします。" << std::endl;
+        }
+        std::cout << "present mode: " << vk::to_string(candidates[i]) << std::endl;
+        return candidates[i];
+    }
+
+    std::cerr << "FIFOが列挙されていないため、先頭のモードを使用します。" << std::endl;
+    return availableModes.front();
+}
+
+vk::SurfaceFormatKHR selectSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats) {
+    // 候補が1つで eUndefined の場合は任意のフォーマットを選べる
+    if (availableFormats.size() == 1 && availableFormats[0].format == vk::Format::eUndefined) {
+        return vk::SurfaceFormatKHR(vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear);
+    }
+
+    // シェーダーの出力をそのまま書き込めるUNORMのフォーマットを優先する
+    for (vk::Format format : { vk::Format::eB8G8R8A8Unorm, vk::Format::eR8G8B8A8Unorm }) {
+        for (const vk::SurfaceFormatKHR& surfaceFormat : availableFormats) {
+            if (surfaceFormat.format == format && surfaceFormat.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
+                return surfaceFormat;
+            }
+        }
+    }
+
+    return availableFormats.front();
+}
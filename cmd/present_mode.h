@@ -0,0 +1,17 @@
+#pragma once
+
+#include "sample_options.h"
+
+#include <vulkan/vulkan.hpp>
+#include <string>
+#include <vector>
+
+// 文字列 (fifo, mailbox, immediate, auto) から選択方針を取得する。不明な文字列ならfalseを返す
+bool parsePresentModePolicy(const std::string& name, PresentModePolicy& policy);
+
+// サーフェースが対応しているモードの中から方針に従ってプレゼンテーションモードを選ぶ
+//  要求したモードに対応していない場合はフォールバックし、その旨を出力する
+vk::PresentModeKHR selectPresentMode(const std::vector<vk::PresentModeKHR>& availableModes, PresentModePolicy policy);
+
+// サーフェースが対応しているフォーマットの中から8bit UNORMのフォーマットを優先して選ぶ
+vk::SurfaceFormatKHR selectSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
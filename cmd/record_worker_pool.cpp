@@ -0,0 +1,126 @@
+#include "record_worker_pool.h"
+
+#include <algorithm>
+
+RecordWorkerPool::RecordWorkerPool(vk::Device device, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t slotCount)
+    : device(device),
+      generation(0),
+      pendingWorkers(0),
+      stopping(false),
+      jobSlotIndex(0),
+      jobInheritanceInfo(nullptr),
+      jobRecordFunc(nullptr) {
+    workerCount = std::max(workerCount, 1u);
+    workers.resize(workerCount);
+
+    for (Worker& worker : workers) {
+        for (uint32_t i = 0; i < slotCount; i++) {
+            // 毎フレームプールごとリセットするためTRANSIENTを指定する
+            vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+            cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+            cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+            worker.cmdPools.push_back(device.createCommandPoolUnique(cmdPoolCreateInfo));
+
+            vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+            cmdBufAllocInfo.commandPool = worker.cmdPools.back().get();
+            cmdBufAllocInfo.commandBufferCount = 1;
+            cmdBufAllocInfo.level = vk::CommandBufferLevel::eSecondary;
+            worker.cmdBufs.push_back(std::move(device.allocateCommandBuffersUnique(cmdBufAllocInfo)[0]));
+        }
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers[i].thread = std::thread(&RecordWorkerPool::run, this, i);
+    }
+}
+
+RecordWorkerPool::~RecordWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+
+    for (Worker& worker : workers) {
+        worker.thread.join();
+    }
+}
+
+std::vector<vk::CommandBuffer> RecordWorkerPool::record(uint32_t slotIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo, const RecordFunc& recordFunc) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobSlotIndex = slotIndex;
+        jobInheritanceInfo = &inheritanceInfo;
+        jobRecordFunc = &recordFunc;
+        jobError = nullptr;
+        pendingWorkers = size();
+        generation++;
+    }
+    startCondition.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [&]() { return pendingWorkers == 0; });
+
+    jobInheritanceInfo = nullptr;
+    jobRecordFunc = nullptr;
+    if (jobError) {
+        std::rethrow_exception(jobError);
+    }
+
+    std::vector<vk::CommandBuffer> cmdBufs;
+    for (Worker& worker : workers) {
+        cmdBufs.push_back(worker.cmdBufs[slotIndex].get());
+    }
+    return cmdBufs;
+}
+
+void RecordWorkerPool::run(uint32_t workerIndex) {
+    Worker& worker = workers[workerIndex];
+    uint64_t handledGeneration = 0;
+
+    while (true) {
+        uint32_t slotIndex;
+        const vk::CommandBufferInheritanceInfo* inheritanceInfo;
+        const RecordFunc* recordFunc;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&]() { return stopping || generation != handledGeneration; });
+            if (stopping) {
+                return;
+            }
+            handledGeneration = generation;
+            slotIndex = jobSlotIndex;
+            inheritanceInfo = jobInheritanceInfo;
+            recordFunc = jobRecordFunc;
+        }
+
+        try {
+            // このスロットの前回分のコマンドをプールごと破棄してから記録し直す
+            device.resetCommandPool(worker.cmdPools[slotIndex].get());
+
+            vk::CommandBuffer cmdBuf = worker.cmdBufs[slotIndex].get();
+
+            // レンダーパスの内側で実行されるセカンダリコマンドバッファとして記録する
+            vk::CommandBufferBeginInfo cmdBeginInfo;
+            cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+            cmdBeginInfo.pInheritanceInfo = inheritanceInfo;
+
+            cmdBuf.begin(cmdBeginInfo);
+            (*recordFunc)(workerIndex, cmdBuf);
+            cmdBuf.end();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!jobError) {
+                jobError = std::current_exception();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingWorkers--;
+            if (pendingWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
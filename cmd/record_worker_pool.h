@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// セカンダリコマンドバッファを複数スレッドで並列に記録するワーカープール
+//  コマンドプールは外部同期が必要なため、ワーカーごと・フレームスロットごとに専用のプールを持つ
+class RecordWorkerPool {
+public:
+    // 各ワーカーのスレッドで呼ばれる記録処理
+    using RecordFunc = std::function<void(uint32_t workerIndex, vk::CommandBuffer secondaryCmdBuf)>;
+
+    RecordWorkerPool(vk::Device device, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t slotCount);
+    ~RecordWorkerPool();
+
+    RecordWorkerPool(const RecordWorkerPool&) = delete;
+    RecordWorkerPool& operator=(const RecordWorkerPool&) = delete;
+
+    uint32_t size() const { return static_cast<uint32_t>(workers.size()); }
+
+    // 全ワーカーにスロット slotIndex のセカンダリコマンドバッファを記録させ、完了を待つ
+    //  スロットの前回の投入分がGPUで完了していることは呼び出し側が保証する
+    //  戻り値はプライマリコマンドバッファの executeCommands() に渡す
+    std::vector<vk::CommandBuffer> record(uint32_t slotIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo, const RecordFunc& recordFunc);
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::vector<vk::UniqueCommandPool> cmdPools;      // フレームスロットごと
+        std::vector<vk::UniqueCommandBuffer> cmdBufs;     // フレームスロットごと
+    };
+
+    void run(uint32_t workerIndex);
+
+    vk::Device device;
+    std::vector<Worker> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation;
+    uint32_t pendingWorkers;
+    bool stopping;
+
+    // 実行中のジョブ (record() の呼び出し中のみ有効)
+    uint32_t jobSlotIndex;
+    const vk::CommandBufferInheritanceInfo* jobInheritanceInfo;
+    const RecordFunc* jobRecordFunc;
+    std::exception_ptr jobError;
+};
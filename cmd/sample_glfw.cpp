@@ -1,4 +1,12 @@
 #include "sample_glfw.h"
+#include "frame_scheduler.h"
+#include "frame_ring.h"
+#include "frame_counter.h"
+#include "frame_profiler.h"
+#include "gpu_timer.h"
+#include "pipeline_stats.h"
+#include "present_mode.h"
+#include "sample_window.h"
 
 #include <iostream>
 #include <vulkan/vulkan.hpp> // vulkanのインクルードが先
@@ -10,73 +18,63 @@ const uint32_t screenWidth = 640;
 const uint32_t screenHeight = 480;
 
 int SampleGLFW::execute() {
+    // 表示先の準備 (ヘッドレスモードではGLFWを使わずVK_EXT_headless_surfaceでサーフェースを作成する)
+    SampleWindow sampleWindow(options);
+
     // GLFWの初期化
-    if (!glfwInit())
+    if (!sampleWindow.init())
         return -1;
 
     // GLFWがVulkanをサポートしているか確認
-    if (glfwVulkanSupported() == GLFW_FALSE) {
+    if (!sampleWindow.isHeadless() && glfwVulkanSupported() == GLFW_FALSE) {
         std::cout << "Vulkan is not supported" << std::endl;
         return -1;
     }
 
-    uint32_t requiredExtensionsCount;
     // サーフェース関連の拡張機能名を取得する
-    const char** requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
+    std::vector<const char*> requiredExtensions = sampleWindow.requiredInstanceExtensions();
     std::cout << "Extensions:" << std::endl;
-    for (int i = 0; i < requiredExtensionsCount; i++) {
+    for (size_t i = 0; i < requiredExtensions.size(); i++) {
         std::cout << "\t" << requiredExtensions[i] << std::endl;
     }
 
+    // タイムラインセマフォを使うためVulkan 1.2を要求する
+    vk::ApplicationInfo appInfo;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
+
     vk::InstanceCreateInfo createInfo;
+    createInfo.pApplicationInfo = &appInfo;
     // Vulkanインスタンスに拡張機能を指定する
-    createInfo.enabledExtensionCount = requiredExtensionsCount;
-    createInfo.ppEnabledExtensionNames = requiredExtensions;
+    createInfo.enabledExtensionCount = requiredExtensions.size();
+    createInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
     // Vulkanのインスタンス作成
     vk::UniqueInstance instance;
     std::cout << "create instance..." << std::endl;
     instance = vk::createInstanceUnique(createInfo);
 
-    // GLFWでウインドウを作成する際のおまじない
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow* window;
     std::cout << "create window..." << std::endl;
-    // ウインドウの作成
-    window = glfwCreateWindow(screenWidth, screenHeight, "GLFW Test Window", NULL, NULL);
-    if (!window) {
-        const char* err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
+    // ウインドウとサーフェースの作成
+    vk::UniqueSurfaceKHR surface = sampleWindow.createSurface(instance.get(), screenWidth, screenHeight, "GLFW Test Window");
+    if (!surface)
         return -1;
-    }
 
-   // ウィンドウサイズ（論理ピクセル）
-    int windowWidth, windowHeight;
-    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    // ピクセルのスケール係数 (ヘッドレスモードでは常に1)
+    uint32_t scaleX = 1;
+    uint32_t scaleY = 1;
+    if (GLFWwindow* window = sampleWindow.handle()) {
+        // ウィンドウサイズ（論理ピクセル）
+        int windowWidth, windowHeight;
+        glfwGetWindowSize(window, &windowWidth, &windowHeight);
 
-    // フレームバッファサイズ（物理ピクセル）
-    int framebufferWidth, framebufferHeight;
-    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
-
-    // ピクセルのスケール係数
-    uint32_t scaleX = static_cast<uint32_t>(framebufferWidth) / windowWidth;
-    uint32_t scaleY = static_cast<uint32_t>(framebufferHeight) / windowHeight;
-    std::cout << "scaleX: " << scaleX << ", scaleY: " << scaleY << std::endl;
+        // フレームバッファサイズ（物理ピクセル）
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-    VkSurfaceKHR c_surface;
-    // サーフェースの作成
-    auto result = glfwCreateWindowSurface(instance.get(), window, nullptr, &c_surface);
-    if (result != VK_SUCCESS) {
-        const char* err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
-        return -1;
+        scaleX = static_cast<uint32_t>(framebufferWidth) / windowWidth;
+        scaleY = static_cast<uint32_t>(framebufferHeight) / windowHeight;
     }
-    // C言語版VulkanをVulkan-Hpp形式に変換する
-    vk::UniqueSurfaceKHR surface{ c_surface, instance.get() };
+    std::cout << "scaleX: " << scaleX << ", scaleY: " << scaleY << std::endl;
 
     // 物理デバイスの列挙
     std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
@@ -116,7 +114,7 @@ int SampleGLFW::execute() {
             !physicalDevices[i].getSurfaceFormatsKHR(surface.get()).empty() ||
             !physicalDevices[i].getSurfacePresentModesKHR(surface.get()).empty();
 
-        if (existsGraphicsQueue && supportsSwapchainExtension && supportsSurface) {
+        if (existsGraphicsQueue && supportsSwapchainExtension && FrameScheduler::isSupported(physicalDevices[i]) && supportsSurface) {
             physicalDevice = physicalDevices[i];
             existsSuitablePhysicalDevice = true;
             break;
@@ -146,17 +144,34 @@ int SampleGLFW::execute() {
     devCreateInfo.pQueueCreateInfos = queueCreateInfo;
     devCreateInfo.queueCreateInfoCount = 1;
 
+    // タイムラインセマフォを有効にする
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    devCreateInfo.pNext = &timelineSemaphoreFeatures;
+
+    // パイプライン統計クエリを使う場合は機能を有効にする
+    bool pipelineStatsEnabled = options.pipelineStats && PipelineStats::isSupported(physicalDevice);
+    if (options.pipelineStats && !pipelineStatsEnabled) {
+        std::cerr << "このデバイスはパイプライン統計クエリに対応していません。" << std::endl;
+    }
+    vk::PhysicalDeviceFeatures enabledFeatures;
+    enabledFeatures.pipelineStatisticsQuery = pipelineStatsEnabled;
+    devCreateInfo.pEnabledFeatures = &enabledFeatures;
+
     // 論理デバイスの作成
     vk::UniqueDevice device = physicalDevice.createDeviceUnique(devCreateInfo);
 
     // グラフィックキューの取得
     vk::Queue graphicsQueue = device->getQueue(graphicsQueueFamilyIndex, 0);
 
+    // GPUの処理完了をタイムライン値で管理するスケジューラ
+    FrameScheduler scheduler(device.get());
+
     std::vector<vk::SurfaceFormatKHR> surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
     std::vector<vk::PresentModeKHR> surfacePresentModes = physicalDevice.getSurfacePresentModesKHR(surface.get());
 
-    vk::SurfaceFormatKHR swapchainFormat = surfaceFormats[0];
-    vk::PresentModeKHR swapchainPresentMode = surfacePresentModes[0];
+    vk::SurfaceFormatKHR swapchainFormat = selectSurfaceFormat(surfaceFormats);
+    vk::PresentModeKHR swapchainPresentMode = selectPresentMode(surfacePresentModes, options.presentModePolicy);
 
     vk::AttachmentDescription attachments[1];
     attachments[0].format = swapchainFormat.format;
@@ -187,23 +202,18 @@ int SampleGLFW::execute() {
 
     vk::UniqueRenderPass renderpass = device->createRenderPassUnique(renderpassCreateInfo);
 
-    vk::Viewport viewports[1];
-    viewports[0].x = 0.0;
-    viewports[0].y = 0.0;
-    viewports[0].minDepth = 0.0;
-    viewports[0].maxDepth = 1.0;
-    viewports[0].width = screenWidth*scaleX;
-    viewports[0].height = screenHeight*scaleY;
-
-    vk::Rect2D scissors[1];
-    scissors[0].offset = vk::Offset2D{ 0, 0 };
-    scissors[0].extent = vk::Extent2D{ screenWidth*scaleX, screenHeight*scaleY };
+    // 現在のスワップチェーンのサイズ (作り直すたびに更新し、ビューポート・シザー・描画範囲に使う)
+    vk::Extent2D swapchainExtent;
 
+    // ビューポートとシザーは記録時にスワップチェーンのサイズで設定する (作り直してもパイプラインはそのまま使える)
     vk::PipelineViewportStateCreateInfo viewportState;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = viewports;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = scissors;
+
+    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.dynamicStateCount = std::size(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates;
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
     vertexInputInfo.vertexAttributeDescriptionCount = 0;
@@ -283,6 +293,7 @@ int SampleGLFW::execute() {
 
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
     pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
     pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
     pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
     pipelineCreateInfo.pRasterizationState = &rasterizer;
@@ -300,29 +311,41 @@ int SampleGLFW::execute() {
     std::vector<vk::Image> swapchainImages;
     std::vector<vk::UniqueImageView> swapchainImageViews;
     std::vector<vk::UniqueFramebuffer> swapchainFramebufs;
+    // 描画完了のセマフォはプレゼンテーションが待ち終わるまで再びシグナルできないため、フレームスロットではなく画像ごとに持つ
+    //  (画像はプレゼンテーションが終わるまで再取得されない)
+    std::vector<vk::UniqueSemaphore> imgRenderedSemaphores;
 
     auto recreateSwapchain = [&](){
-        swapchainFramebufs.clear();
-        swapchainImageViews.clear();
+        // 古いスワップチェーンやフレームバッファは投入済みのフレームがまだ使っている可能性がある
+        // GPUの完了を待って止まる代わりに、投入済みの全フレームが完了するまで破棄を遅らせる
+        uint64_t retireValue = scheduler.submittedValue();
+        scheduler.destroyAfter(retireValue, std::move(swapchainFramebufs));
+        scheduler.destroyAfter(retireValue, std::move(swapchainImageViews));
+        scheduler.destroyAfter(retireValue, std::move(imgRenderedSemaphores));
         swapchainImages.clear();
-        swapchain.reset();
+
+        // 古いスワップチェーンを渡すと、ドライバは表示中の画像やメモリを新しいスワップチェーンに引き継げる
+        vk::UniqueSwapchainKHR oldSwapchain = std::move(swapchain);
 
         vk::SurfaceCapabilitiesKHR surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface.get());
+        swapchainExtent = sampleWindow.extent(surfaceCapabilities);
 
         vk::SwapchainCreateInfoKHR swapchainCreateInfo;
         swapchainCreateInfo.surface = surface.get();
         swapchainCreateInfo.minImageCount = surfaceCapabilities.minImageCount + 1;
         swapchainCreateInfo.imageFormat = swapchainFormat.format;
         swapchainCreateInfo.imageColorSpace = swapchainFormat.colorSpace;
-        swapchainCreateInfo.imageExtent = surfaceCapabilities.currentExtent;
+        swapchainCreateInfo.imageExtent = swapchainExtent;
         swapchainCreateInfo.imageArrayLayers = 1;
         swapchainCreateInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
         swapchainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
         swapchainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
         swapchainCreateInfo.presentMode = swapchainPresentMode;
         swapchainCreateInfo.clipped = VK_TRUE;
+        swapchainCreateInfo.oldSwapchain = oldSwapchain.get();
 
         swapchain = device->createSwapchainKHRUnique(swapchainCreateInfo);
+        scheduler.destroyAfter(retireValue, std::move(oldSwapchain));
 
         swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
 
@@ -346,6 +369,11 @@ int SampleGLFW::execute() {
             swapchainImageViews[i] = device->createImageViewUnique(imgViewCreateInfo);
         }
 
+        imgRenderedSemaphores.resize(swapchainImages.size());
+        for (size_t i = 0; i < swapchainImages.size(); i++) {
+            imgRenderedSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+        }
+
         swapchainFramebufs.resize(swapchainImages.size());
 
         for (size_t i = 0; i < swapchainImages.size(); i++) {
@@ -353,8 +381,8 @@ int SampleGLFW::execute() {
             frameBufAttachments[0] = swapchainImageViews[i].get();
 
             vk::FramebufferCreateInfo frameBufCreateInfo;
-            frameBufCreateInfo.width = surfaceCapabilities.currentExtent.width;
-            frameBufCreateInfo.height = surfaceCapabilities.currentExtent.height;
+            frameBufCreateInfo.width = swapchainExtent.width;
+            frameBufCreateInfo.height = swapchainExtent.height;
             frameBufCreateInfo.layers = 1;
             frameBufCreateInfo.renderPass = renderpass.get();
             frameBufCreateInfo.attachmentCount = 1;
@@ -366,52 +394,63 @@ int SampleGLFW::execute() {
 
     recreateSwapchain();
 
-    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
-    cmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    vk::UniqueCommandPool cmdPool = device->createCommandPoolUnique(cmdPoolCreateInfo);
-
-    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
-    cmdBufAllocInfo.commandPool = cmdPool.get();
-    cmdBufAllocInfo.commandBufferCount = 1;
-    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-    std::vector<vk::UniqueCommandBuffer> cmdBufs =
-        device->allocateCommandBuffersUnique(cmdBufAllocInfo);
-
-    vk::SemaphoreCreateInfo semaphoreCreateInfo;
-
-    vk::UniqueSemaphore swapchainImgSemaphore, imgRenderedSemaphore;
-    swapchainImgSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
-    imgRenderedSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
-
-    vk::FenceCreateInfo fenceCreateInfo;
-    fenceCreateInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-
-    vk::UniqueFence imgRenderedFence = device->createFenceUnique(fenceCreateInfo);
-
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-
-        device->waitForFences({ imgRenderedFence.get()}, VK_TRUE, UINT64_MAX);
+    // フレームスロットのリング (スロットごとにコマンドバッファとセマフォを持つ)
+    FrameRing frameRing(device.get(), scheduler, graphicsQueueFamilyIndex, options.framesInFlight);
+    FrameCounter frameCounter;
+    // 処理段階ごとのCPU時間 (終了時に分布を出力する)
+    FrameProfiler profiler;
+    // タイムスタンプクエリによるGPU時間 (--gpu-timestamps 指定時のみ)
+    GpuTimer gpuTimer(device.get(), physicalDevice, graphicsQueueFamilyIndex, options.gpuTimestamps, frameRing.size());
+    // パイプライン統計クエリ (--stats 指定時のみ)
+    PipelineStats pipelineStats(device.get(), pipelineStatsEnabled, frameRing.size());
+
+    while (!sampleWindow.shouldClose(frameCounter.count())) {
+        profiler.begin(FrameStage::PollEvents);
+        sampleWindow.pollEvents();
+        profiler.end(FrameStage::PollEvents);
+
+        // 次のフレームスロットを取得する (スロットの前回の描画が終わるまで待つ)
+        profiler.begin(FrameStage::WaitFrame);
+        FrameSlot& frame = frameRing.acquire();
+        profiler.end(FrameStage::WaitFrame);
+        // 完了したフレームに紐づく遅延処理を実行する
+        scheduler.retire();
+
+        // リサイズ負荷の計測用: 一定フレームごとに表示サイズを変えてスワップチェーンを作り直す
+        if (sampleWindow.churnResize(frameCounter.count())) {
+            recreateSwapchain();
+        }
 
-        vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, swapchainImgSemaphore.get());
-        if(acquireImgResult.result == vk::Result::eSuboptimalKHR || acquireImgResult.result == vk::Result::eErrorOutOfDateKHR) {
+        frameCounter.markAcquire();
+        vk::Result acquireResult;
+        uint32_t imgIndex = 0;
+        profiler.begin(FrameStage::Acquire);
+        try {
+            vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, frame.swapchainImgSemaphore.get());
+            acquireResult = acquireImgResult.result;
+            imgIndex = acquireImgResult.value;
+        } catch (const vk::OutOfDateKHRError&) {
+            acquireResult = vk::Result::eErrorOutOfDateKHR;
+        }
+        profiler.end(FrameStage::Acquire);
+        if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+            // 画像を取得できていないため、このフレームは描画せずに作り直す
             std::cerr << "スワップチェーンを再作成します。" << std::endl;
             recreateSwapchain();
             continue;
         }
-        if (acquireImgResult.result != vk::Result::eSuccess) {
+        if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR) {
             std::cerr << "次フレームの取得に失敗しました。" << std::endl;
             return -1;
         }
-        device->resetFences({ imgRenderedFence.get() });
-
-        uint32_t imgIndex = acquireImgResult.value;
 
-        cmdBufs[0]->reset();
+        profiler.begin(FrameStage::Record);
+        frame.cmdBuf->reset();
 
         vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBufs[0]->begin(cmdBeginInfo);
+        frame.cmdBuf->begin(cmdBeginInfo);
+        gpuTimer.beginFrame(frame.cmdBuf.get(), frameRing.currentIndex());
+        pipelineStats.beginFrame(frame.cmdBuf.get(), frameRing.currentIndex());
 
         vk::ClearValue clearVal[1];
         clearVal[0].color.float32[0] = 0.0f;
@@ -422,35 +461,46 @@ int SampleGLFW::execute() {
         vk::RenderPassBeginInfo renderpassBeginInfo;
         renderpassBeginInfo.renderPass = renderpass.get();
         renderpassBeginInfo.framebuffer = swapchainFramebufs[imgIndex].get();
-        renderpassBeginInfo.renderArea = vk::Rect2D({ 0,0 }, { screenWidth*scaleX, screenHeight*scaleY });
+        renderpassBeginInfo.renderArea = vk::Rect2D({0, 0}, swapchainExtent);
         renderpassBeginInfo.clearValueCount = 1;
         renderpassBeginInfo.pClearValues = clearVal;
 
-        cmdBufs[0]->beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+        uint32_t renderPassScope = gpuTimer.beginScope(frame.cmdBuf.get(), "render pass");
+        frame.cmdBuf->beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
 
-        cmdBufs[0]->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
-        cmdBufs[0]->draw(3, 1, 0, 0);
+        frame.cmdBuf->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        frame.cmdBuf->setViewport(0, {vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), 0.0f, 1.0f)});
+        frame.cmdBuf->setScissor(0, {vk::Rect2D({0, 0}, swapchainExtent)});
+        uint32_t drawScope = gpuTimer.beginScope(frame.cmdBuf.get(), "draw");
+        uint32_t drawStatsScope = pipelineStats.beginScope(frame.cmdBuf.get(), "draw");
+        frame.cmdBuf->draw(3, 1, 0, 0);
+        pipelineStats.endScope(frame.cmdBuf.get(), drawStatsScope);
+        gpuTimer.endScope(frame.cmdBuf.get(), drawScope);
 
-        cmdBufs[0]->endRenderPass();
+        frame.cmdBuf->endRenderPass();
+        gpuTimer.endScope(frame.cmdBuf.get(), renderPassScope);
 
-        cmdBufs[0]->end();
+        frame.cmdBuf->end();
+        profiler.end(FrameStage::Record);
 
-        vk::CommandBuffer submitCmdBuf[1] = { cmdBufs[0].get() };
+        vk::CommandBuffer submitCmdBuf[1] = { frame.cmdBuf.get() };
         vk::SubmitInfo submitInfo;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = submitCmdBuf;
 
-        vk::Semaphore renderwaitSemaphores[] = { swapchainImgSemaphore.get() };
+        vk::Semaphore renderwaitSemaphores[] = { frame.swapchainImgSemaphore.get() };
         vk::PipelineStageFlags renderwaitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = renderwaitSemaphores;
         submitInfo.pWaitDstStageMask = renderwaitStages;
 
-        vk::Semaphore renderSignalSemaphores[] = { imgRenderedSemaphore.get() };
+        vk::Semaphore renderSignalSemaphores[] = { imgRenderedSemaphores[imgIndex].get() };
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = renderSignalSemaphores;
 
-        graphicsQueue.submit({ submitInfo }, imgRenderedFence.get());
+        profiler.begin(FrameStage::Submit);
+        frame.timelineValue = scheduler.submit(graphicsQueue, submitInfo);
+        profiler.end(FrameStage::Submit);
 
         vk::PresentInfoKHR presentInfo;
 
@@ -461,14 +511,34 @@ int SampleGLFW::execute() {
         presentInfo.pSwapchains = presentSwapchains.begin();
         presentInfo.pImageIndices = imgIndices.begin();
 
-        vk::Semaphore presenWaitSemaphores[] = { imgRenderedSemaphore.get() };
+        vk::Semaphore presenWaitSemaphores[] = { imgRenderedSemaphores[imgIndex].get() };
         presentInfo.waitSemaphoreCount = 1;
         presentInfo.pWaitSemaphores = presenWaitSemaphores;
 
-        graphicsQueue.presentKHR(presentInfo);
+        // SUBOPTIMALの場合は取得済みの画像を表示してからスワップチェーンを作り直す
+        bool needsRecreate = acquireResult == vk::Result::eSuboptimalKHR;
+        profiler.begin(FrameStage::Present);
+        try {
+            needsRecreate |= graphicsQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR;
+        } catch (const vk::OutOfDateKHRError&) {
+            needsRecreate = true;
+        }
+        profiler.end(FrameStage::Present);
+
+        frameCounter.tick();
+
+        if (needsRecreate) {
+            std::cerr << "スワップチェーンを再作成します。" << std::endl;
+            recreateSwapchain();
+        }
     }
 
     graphicsQueue.waitIdle();
-    glfwTerminate();
+    // 破棄を遅らせていたオブジェクトを、参照先(コマンドプールなど)より先に破棄する
+    scheduler.retire();
+    frameCounter.report(std::cout);
+    profiler.report(std::cout);
+    gpuTimer.report(std::cout);
+    pipelineStats.report(std::cout);
     return 0;
 }
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "command.h"
+#include "sample_options.h"
 
 class SampleGLFW : public Command {
 public:
-    SampleGLFW() {};
+    SampleGLFW(const SampleOptions& options) : options(options) {};
     ~SampleGLFW() override {};
 
     int execute() override;
+
+private:
+    SampleOptions options;
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// プレゼンテーションモードの選択方針
+enum class PresentModePolicy {
+    Fifo,              // 垂直同期 (全ての環境でサポートされる)
+    Mailbox,           // 垂直同期ありで最新フレームを表示する (非対応ならFIFO)
+    Immediate,         // 垂直同期なし (非対応ならMAILBOX→FIFO)
+    AutoLowestLatency, // ティアリングなしで最も低レイテンシなモードを自動で選ぶ
+};
+
+// スワップチェーンを使うサンプル共通の実行オプション
+struct SampleOptions {
+    // 同時に処理中にできるフレーム数 (1ならCPUは毎フレームGPUの完了を待つ)
+    uint32_t framesInFlight = 2;
+
+    // プレゼンテーションモードの選択方針
+    PresentModePolicy presentModePolicy = PresentModePolicy::AutoLowestLatency;
+
+    // ウインドウを作らずVK_EXT_headless_surfaceに描画する
+    bool headless = false;
+
+    // 描画するフレーム数 (0なら無制限)
+    uint64_t frameCount = 0;
+
+    // 指定フレームごとに表示サイズを変えてスワップチェーンを作り直す (0なら無効。リサイズ負荷の計測用)
+    uint32_t resizeChurnInterval = 0;
+
+    // 静的シーンモード: スワップチェーン画像ごとにコマンドバッファを一度だけ記録し、毎フレームは投入のみ行う
+    bool staticScene = false;
+
+    // セカンダリコマンドバッファを並列に記録するスレッド数 (0ならプライマリに直接記録する)
+    uint32_t recordThreads = 0;
+
+    // 1フレームあたりの描画コマンド数 (記録時間の計測用)
+    uint32_t drawCount = 1;
+
+    // タイムスタンプクエリでGPU時間を計測する
+    bool gpuTimestamps = false;
+
+    // パイプライン統計クエリで描画ごとのパイプライン各段の処理数を計測する
+    bool pipelineStats = false;
+
+    // 毎フレーム頂点データを書き換え、永続マップしたアップロードリングから描画する
+    bool dynamicGeometry = false;
+
+    // これを超えるサイズのリソースはブロックから切り出さず専用のメモリを確保する (0ならアロケータの既定値)
+    uint64_t dedicatedThreshold = 0;
+};
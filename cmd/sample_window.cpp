@@ -0,0 +1,139 @@
+#include "sample_window.h"
+
+#include <vulkan/vulkan.hpp> // vulkanのインクルードが先
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iostream>
+
+SampleWindow::SampleWindow(const SampleOptions& options)
+    : headless(options.headless),
+      frameCount(options.frameCount),
+      resizeChurnInterval(options.resizeChurnInterval),
+      lastResizeFrame(0),
+      enlarged(false),
+      glfwInitialized(false),
+      window(nullptr) {}
+
+SampleWindow::~SampleWindow() {
+    if (window) {
+        glfwDestroyWindow(window);
+    }
+    if (glfwInitialized) {
+        glfwTerminate();
+    }
+}
+
+bool SampleWindow::init() {
+    if (headless) {
+        return true;
+    }
+
+    glfwInitialized = glfwInit() == GLFW_TRUE;
+    return glfwInitialized;
+}
+
+std::vector<const char*> SampleWindow::requiredInstanceExtensions() const {
+    if (headless) {
+        return { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+    }
+
+    // サーフェース関連の拡張機能名をGLFWから取得する
+    uint32_t requiredExtensionsCount;
+    const char** requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
+    if (!requiredExtensions) {
+        return {};
+    }
+    return std::vector<const char*>(requiredExtensions, requiredExtensions + requiredExtensionsCount);
+}
+
+vk::UniqueSurfaceKHR SampleWindow::createSurface(vk::Instance instance, uint32_t width, uint32_t height, const char* title) {
+    baseExtent = vk::Extent2D{ width, height };
+    requestedExtent = baseExtent;
+
+    VkSurfaceKHR c_surface;
+
+    if (headless) {
+        // 拡張機能の関数はリンクされていない場合があるため関数ポインタを取得して呼び出す
+        auto createHeadlessSurface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(instance.getProcAddr("vkCreateHeadlessSurfaceEXT"));
+        if (!createHeadlessSurface) {
+            std::cerr << "VK_EXT_headless_surfaceが利用できません。" << std::endl;
+            return vk::UniqueSurfaceKHR();
+        }
+
+        VkHeadlessSurfaceCreateInfoEXT surfaceCreateInfo = {};
+        surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+        if (createHeadlessSurface(instance, &surfaceCreateInfo, nullptr, &c_surface) != VK_SUCCESS) {
+            std::cerr << "ヘッドレスサーフェースの作成に失敗しました。" << std::endl;
+            return vk::UniqueSurfaceKHR();
+        }
+        return vk::UniqueSurfaceKHR{ c_surface, instance };
+    }
+
+    // GLFWでウインドウを作成する際のおまじない
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (!window) {
+        const char* err;
+        glfwGetError(&err);
+        std::cout << err << std::endl;
+        return vk::UniqueSurfaceKHR();
+    }
+
+    auto result = glfwCreateWindowSurface(instance, window, nullptr, &c_surface);
+    if (result != VK_SUCCESS) {
+        const char* err;
+        glfwGetError(&err);
+        std::cout << err << std::endl;
+        return vk::UniqueSurfaceKHR();
+    }
+    // C言語版VulkanをVulkan-Hpp形式に変換する
+    return vk::UniqueSurfaceKHR{ c_surface, instance };
+}
+
+vk::Extent2D SampleWindow::extent(const vk::SurfaceCapabilitiesKHR& surfaceCapabilities) const {
+    if (surfaceCapabilities.currentExtent.width != UINT32_MAX) {
+        return surfaceCapabilities.currentExtent;
+    }
+
+    vk::Extent2D swapchainExtent;
+    swapchainExtent.width = std::clamp(requestedExtent.width, surfaceCapabilities.minImageExtent.width, surfaceCapabilities.maxImageExtent.width);
+    swapchainExtent.height = std::clamp(requestedExtent.height, surfaceCapabilities.minImageExtent.height, surfaceCapabilities.maxImageExtent.height);
+    return swapchainExtent;
+}
+
+bool SampleWindow::churnResize(uint64_t renderedFrames) {
+    if (resizeChurnInterval == 0 || renderedFrames == 0 || renderedFrames % resizeChurnInterval != 0) {
+        return false;
+    }
+    // スワップチェーンの取得に失敗して同じフレーム数のまま呼ばれた場合は切り替えない
+    if (renderedFrames == lastResizeFrame) {
+        return false;
+    }
+    lastResizeFrame = renderedFrames;
+
+    // 作成時のサイズと1.25倍のサイズを交互に切り替える
+    enlarged = !enlarged;
+    if (enlarged) {
+        requestedExtent = vk::Extent2D{ baseExtent.width * 5 / 4, baseExtent.height * 5 / 4 };
+    } else {
+        requestedExtent = baseExtent;
+    }
+
+    if (window) {
+        glfwSetWindowSize(window, requestedExtent.width, requestedExtent.height);
+    }
+    return true;
+}
+
+bool SampleWindow::shouldClose(uint64_t renderedFrames) const {
+    if (frameCount > 0 && renderedFrames >= frameCount) {
+        return true;
+    }
+    return window && glfwWindowShouldClose(window);
+}
+
+void SampleWindow::pollEvents() {
+    if (!headless) {
+        glfwPollEvents();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sample_options.h"
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+
+struct GLFWwindow;
+
+// サンプルの表示先 (GLFWのウインドウ、またはVK_EXT_headless_surfaceによるヘッドレスサーフェース)
+//  ヘッドレスモードではウインドウを作らないため、ディスプレイのない環境でも
+//  取得・記録・投入・表示の一連の処理を指定フレーム数だけ実行できる
+class SampleWindow {
+public:
+    explicit SampleWindow(const SampleOptions& options);
+    ~SampleWindow();
+
+    SampleWindow(const SampleWindow&) = delete;
+    SampleWindow& operator=(const SampleWindow&) = delete;
+
+    // GLFWを初期化する (ヘッドレスモードでは何もしない)
+    bool init();
+
+    // Vulkanインスタンスに指定する必要のある拡張機能
+    std::vector<const char*> requiredInstanceExtensions() const;
+
+    // ウインドウとサーフェースを作成する。失敗した場合は空のハンドルを返す
+    vk::UniqueSurfaceKHR createSurface(vk::Instance instance, uint32_t width, uint32_t height, const char* title);
+
+    // スワップチェーンのサイズを決める
+    //  サーフェース側でサイズが決まらない場合(ヘッドレスなど)は作成時のサイズを使う
+    vk::Extent2D extent(const vk::SurfaceCapabilitiesKHR& surfaceCapabilities) const;
+
+    // --resize-churn 指定時、一定フレームごとに表示サイズを2つのサイズの間で切り替える
+    //  サイズを変えた場合はtrueを返すので、呼び出し側はスワップチェーンを作り直す
+    bool churnResize(uint64_t renderedFrames);
+
+    // レンダーループを終了するか (ウインドウが閉じられたか、指定フレーム数に達したか)
+    bool shouldClose(uint64_t renderedFrames) const;
+
+    void pollEvents();
+
+    bool isHeadless() const { return headless; }
+
+    // ヘッドレスモードではnullptr
+    GLFWwindow* handle() const { return window; }
+
+private:
+    bool headless;
+    uint64_t frameCount;
+    uint32_t resizeChurnInterval;
+    uint64_t lastResizeFrame;
+    bool enlarged;
+    bool glfwInitialized;
+    GLFWwindow* window;
+    vk::Extent2D baseExtent;      // 作成時のサイズ
+    vk::Extent2D requestedExtent; // 現在要求しているサイズ
+};
@@ -1,4 +1,6 @@
 #include "simple_triangle.h"
+#include "device_allocator.h"
+#include "memory_type.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h" // 画像書き出し用
@@ -13,6 +15,11 @@
 int SimpleTriangle::execute() {
     vk::InstanceCreateInfo createInfo;
 
+    // 専用割り当て (getImageMemoryRequirements2() など) を使うため Vulkan 1.1 を要求する
+    vk::ApplicationInfo appInfo;
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+    createInfo.pApplicationInfo = &appInfo;
+
     // Vulkanのインスタンス作成
     vk::UniqueInstance instance;
     instance = vk::createInstanceUnique(createInfo);
@@ -108,31 +115,23 @@ int SimpleTriangle::execute() {
     // デバイスが持っているメモリの種類を取得する
     vk::PhysicalDeviceMemoryProperties memProps = physicalDevice.getMemoryProperties();
 
-    vk::MemoryAllocateInfo imgMemAllocInfo;
-    imgMemAllocInfo.allocationSize = imgMemReq.size;
-
-    // 利用可能なメモリを選択する
-    bool suitableMemoryTypeFound = false;
-    for (size_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if (imgMemReq.memoryTypeBits & (1 << i)  // メモリが利用可能なビットが立っているかをチェック
-                && (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {  // GPUを操作しているホストから参照できるメモリであるかをチェック
-            // 一番最初にビットが立っているメモリを使用する
-            imgMemAllocInfo.memoryTypeIndex = i;
-            suitableMemoryTypeFound = true;
-            break;
-        }
-    }
-
-    if (!suitableMemoryTypeFound) {
+    // 利用可能なメモリを選択する (描画結果をホストで読み出すため、ホストキャッシュ付きのメモリを優先する)
+    uint32_t imgMemTypeIndex = selectMemoryType(memProps, imgMemReq.memoryTypeBits, MemoryUsage::Readback);
+    if (imgMemTypeIndex == UINT32_MAX) {
         std::cerr << "使用可能なメモリタイプがありません。" << std::endl;
         return -1;
     }
 
-    // デバイスメモリを確保する
-    vk::UniqueDeviceMemory imgMem = device->allocateMemoryUnique(imgMemAllocInfo);
+    // デバイスメモリをブロック単位で確保するアロケータ (リソースごとに allocateMemory() しない)
+    DeviceAllocator allocator(physicalDevice, device.get());
+
+    // 大きなオフスクリーンの描画先は、ドライバが望めばブロックから切り出さずに専用のメモリを確保する
+    bool dedicatedSupported = DeviceAllocator::isDedicatedAllocationSupported(physicalDevice);
+    allocator.configureDedicatedAllocation(dedicatedSupported, options.dedicatedThreshold > 0 ? options.dedicatedThreshold : allocator.getDedicatedThreshold());
 
-    // 画像のメモリを紐づける
-    device->bindImageMemory(image.get(), imgMem.get(), 0); // 第三引数の0はメモリの何バイト目から利用するかのアドレス
+    // ブロックから画像用の領域を切り出し、画像のメモリを紐づける (bindImageMemory() のオフセットはアロケータが決める)
+    DeviceAllocation imgMem = allocator.allocateForImage(image.get(), imgMemTypeIndex, MemoryUsage::Readback, imgCreateInfo.tiling);
+    allocator.report(std::cout);
 
     // アタッチメントの初期化オブジェクトの用意 (アタッチメント=サブパスで利用するテクスチャだったり、描画対象の画像として利用される)
     vk::AttachmentDescription attachments[1];
@@ -359,12 +358,11 @@ int SimpleTriangle::execute() {
     // キューがからになるまで待つ
     graphicsQueue.waitIdle();
 
-    // GPUのメモリをホストのメモリにマップする
-    void* imgData = device->mapMemory(imgMem.get(), 0, imgMemReq.size);
+    // GPUの書き込みをホストから見えるようにする (ホスト可視のブロックはアロケータがマップ済み)
+    imgMem.invalidate();
+    void* imgData = imgMem.mapped();
     // 画像ファイルを書き出す
     stbi_write_bmp("img.bmp", screenWidth, screenHeight, 4, imgData);
-    // マップしたメモリをアンマップする
-    device->unmapMemory(imgMem.get());
 
     return 0;
 }
\ No newline at end of file
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "command.h"
+#include "sample_options.h"
 
 class SimpleTriangle : public Command {
 public:
-    SimpleTriangle() {};
+    SimpleTriangle(const SampleOptions& options) : options(options) {};
     ~SimpleTriangle() override {};
 
     int execute() override;
+
+private:
+    SampleOptions options;
 };
\ No newline at end of file
@@ -1,9 +1,27 @@
 #include "staging_buffer.h"
+#include "frame_scheduler.h"
+#include "frame_ring.h"
+#include "frame_counter.h"
+#include "frame_profiler.h"
+#include "gpu_timer.h"
+#include "pipeline_stats.h"
+#include "present_mode.h"
+#include "sample_window.h"
+#include "record_worker_pool.h"
+#include "device_allocator.h"
+#include "upload_ring.h"
+#include "memory_budget.h"
+#include "buffer_pool.h"
+#include "memory_type.h"
+#include "upload_context.h"
+#include "geometry_arena.h"
+#include "mapped_copy.h"
 #include <vulkan/vulkan.hpp>
-#include <GLFW/glfw3.h>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 const uint32_t screenWidth = 640;
 const uint32_t screenHeight = 480;
@@ -31,40 +49,28 @@ static std::vector<Vertex> vertices = {
 static std::vector<uint16_t> indices = {0, 1, 2, 1, 0, 3};
 
 int StagingBuffer::execute() {
-    if (!glfwInit())
+    // 表示先の準備 (ヘッドレスモードではウインドウを作成しない)
+    SampleWindow sampleWindow(options);
+    if (!sampleWindow.init())
         return -1;
 
-    uint32_t requiredExtensionsCount;
-    const char **requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
+    std::vector<const char*> requiredExtensions = sampleWindow.requiredInstanceExtensions();
+
+    // タイムラインセマフォを使うためVulkan 1.2を要求する
+    vk::ApplicationInfo appInfo;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     vk::InstanceCreateInfo createInfo;
-    createInfo.enabledExtensionCount = requiredExtensionsCount;
-    createInfo.ppEnabledExtensionNames = requiredExtensions;
+    createInfo.pApplicationInfo = &appInfo;
+    createInfo.enabledExtensionCount = requiredExtensions.size();
+    createInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
     vk::UniqueInstance instance;
     instance = vk::createInstanceUnique(createInfo);
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow *window;
-    window = glfwCreateWindow(screenWidth, screenHeight, "GLFW Test Window", NULL, NULL);
-    if (!window) {
-        const char *err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-
-    VkSurfaceKHR c_surface;
-    auto result = glfwCreateWindowSurface(instance.get(), window, nullptr, &c_surface);
-    if (result != VK_SUCCESS) {
-        const char *err;
-        glfwGetError(&err);
-        std::cout << err << std::endl;
-        glfwTerminate();
+    vk::UniqueSurfaceKHR surface = sampleWindow.createSurface(instance.get(), screenWidth, screenHeight, "GLFW Test Window");
+    if (!surface)
         return -1;
-    }
-    vk::UniqueSurfaceKHR surface{c_surface, instance.get()};
 
     std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
 
@@ -94,7 +100,7 @@ int StagingBuffer::execute() {
             }
         }
 
-        if (existsGraphicsQueue && supportsSwapchainExtension) {
+        if (existsGraphicsQueue && supportsSwapchainExtension && FrameScheduler::isSupported(physicalDevices[i])) {
             physicalDevice = physicalDevices[i];
             existsSuitablePhysicalDevice = true;
             break;
@@ -108,12 +114,23 @@ int StagingBuffer::execute() {
 
     vk::DeviceCreateInfo devCreateInfo;
 
-    auto devRequiredExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char*> devRequiredExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+    // ドライバが報告するヒープごとの予算を使うため、対応していれば VK_EXT_memory_budget を有効にする
+    bool memoryBudgetEnabled = MemoryBudget::isSupported(physicalDevice);
+    if (memoryBudgetEnabled) {
+        devRequiredExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     devCreateInfo.enabledExtensionCount = devRequiredExtensions.size();
-    devCreateInfo.ppEnabledExtensionNames = devRequiredExtensions.begin();
+    devCreateInfo.ppEnabledExtensionNames = devRequiredExtensions.data();
+
+    // 転送専用のキューファミリーがあれば、アップロードをそこで実行して描画と並行させる
+    //  ない場合 (CPU実装のドライバなど) はグラフィックスキューでコピーする
+    uint32_t transferQueueFamilyIndex = UploadContext::findTransferQueueFamily(physicalDevice);
+    bool useTransferQueue = transferQueueFamilyIndex != UINT32_MAX;
 
-    vk::DeviceQueueCreateInfo queueCreateInfo[1];
+    vk::DeviceQueueCreateInfo queueCreateInfo[2];
     queueCreateInfo[0].queueFamilyIndex = graphicsQueueFamilyIndex;
     queueCreateInfo[0].queueCount = 1;
 
@@ -121,232 +138,80 @@ int StagingBuffer::execute() {
 
     queueCreateInfo[0].pQueuePriorities = queuePriorities;
 
-    devCreateInfo.pQueueCreateInfos = queueCreateInfo;
-    devCreateInfo.queueCreateInfoCount = 1;
-
-    vk::UniqueDevice device = physicalDevice.createDeviceUnique(devCreateInfo);
-
-    vk::Queue graphicsQueue = device->getQueue(graphicsQueueFamilyIndex, 0);
-
-    vk::PhysicalDeviceMemoryProperties memProps = physicalDevice.getMemoryProperties();
-
-    vk::BufferCreateInfo vertBufferCreateInfo;
-    vertBufferCreateInfo.size = sizeof(Vertex) * vertices.size();
-    vertBufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
-    vertBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
-
-    vk::UniqueBuffer vertexBuf = device->createBufferUnique(vertBufferCreateInfo);
-
-    vk::MemoryRequirements vertexBufMemReq = device->getBufferMemoryRequirements(vertexBuf.get());
-
-    vk::MemoryAllocateInfo vertexBufMemAllocInfo;
-    vertexBufMemAllocInfo.allocationSize = vertexBufMemReq.size;
-
-    bool suitableMemoryTypeFound = false;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if (vertexBufMemReq.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
-            vertexBufMemAllocInfo.memoryTypeIndex = i;
-            suitableMemoryTypeFound = true;
-            break;
-        }
-    }
-    if (!suitableMemoryTypeFound) {
-        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
-        return -1;
-    }
-
-    vk::UniqueDeviceMemory vertexBufMemory = device->allocateMemoryUnique(vertexBufMemAllocInfo);
-
-    device->bindBufferMemory(vertexBuf.get(), vertexBufMemory.get(), 0);
-
-    {
-        // 頂点バッファの作成
-        vk::BufferCreateInfo stagingBufferCreateInfo;
-        stagingBufferCreateInfo.size = sizeof(Vertex) * vertices.size();
-        stagingBufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
-        stagingBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
-        // ステージングバッファの作成
-        vk::UniqueBuffer stagingBuf = device->createBufferUnique(stagingBufferCreateInfo);
-
-        vk::MemoryRequirements stagingBufMemReq = device->getBufferMemoryRequirements(stagingBuf.get());
-
-        vk::MemoryAllocateInfo stagingBufMemAllocInfo;
-        stagingBufMemAllocInfo.allocationSize = stagingBufMemReq.size;
-
-        suitableMemoryTypeFound = false;
-        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-            if (stagingBufMemReq.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
-                stagingBufMemAllocInfo.memoryTypeIndex = i;
-                suitableMemoryTypeFound = true;
-                break;
-            }
-        }
-        if (!suitableMemoryTypeFound) {
-            std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
-            return -1;
-        }
-
-        // メモリマッピングでデータを書き込む
-        vk::UniqueDeviceMemory stagingBufMemory = device->allocateMemoryUnique(stagingBufMemAllocInfo);
-
-        device->bindBufferMemory(stagingBuf.get(), stagingBufMemory.get(), 0);
-
-        void *pStagingBufMem = device->mapMemory(stagingBufMemory.get(), 0, sizeof(Vertex) * vertices.size());
-
-        std::memcpy(pStagingBufMem, vertices.data(), sizeof(Vertex) * vertices.size());
-
-        vk::MappedMemoryRange flushMemoryRange;
-        flushMemoryRange.memory = stagingBufMemory.get();
-        flushMemoryRange.offset = 0;
-        flushMemoryRange.size = sizeof(Vertex) * vertices.size();
-
-        device->flushMappedMemoryRanges({flushMemoryRange});
-
-        device->unmapMemory(stagingBufMemory.get());
-
-        // データの転送 (GPUにコマンドを送信してコピーさせる)
-        vk::CommandPoolCreateInfo tmpCmdPoolCreateInfo;
-        tmpCmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-        tmpCmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient; // 直ぐに使って直ぐに役目を終える用のフラグ
-        vk::UniqueCommandPool tmpCmdPool = device->createCommandPoolUnique(tmpCmdPoolCreateInfo);
+    queueCreateInfo[1].queueFamilyIndex = transferQueueFamilyIndex;
+    queueCreateInfo[1].queueCount = 1;
+    queueCreateInfo[1].pQueuePriorities = queuePriorities;
 
-        vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
-        tmpCmdBufAllocInfo.commandPool = tmpCmdPool.get();
-        tmpCmdBufAllocInfo.commandBufferCount = 1;
-        tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-        std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
-
-        vk::BufferCopy bufCopy;
-        bufCopy.srcOffset = 0;
-        bufCopy.dstOffset = 0;
-        bufCopy.size = sizeof(Vertex) * vertices.size();
-
-        vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-        // コピーコマンドの送信
-        tmpCmdBufs[0]->begin(cmdBeginInfo);
-        tmpCmdBufs[0]->copyBuffer(stagingBuf.get(), vertexBuf.get(), {bufCopy});
-        tmpCmdBufs[0]->end();
-
-        vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
-        vk::SubmitInfo submitInfo;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = submitCmdBuf;
-
-        graphicsQueue.submit({submitInfo});
-        graphicsQueue.waitIdle();
-    }
-
-    vk::BufferCreateInfo indexBufferCreateInfo;
-    indexBufferCreateInfo.size = sizeof(uint16_t) * indices.size();
-    indexBufferCreateInfo.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
-    indexBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
-
-    vk::UniqueBuffer indexBuf = device->createBufferUnique(indexBufferCreateInfo);
-
-    vk::MemoryRequirements indexBufMemReq = device->getBufferMemoryRequirements(indexBuf.get());
+    devCreateInfo.pQueueCreateInfos = queueCreateInfo;
+    devCreateInfo.queueCreateInfoCount = useTransferQueue ? 2 : 1;
 
-    vk::MemoryAllocateInfo indexBufMemAllocInfo;
-    indexBufMemAllocInfo.allocationSize = indexBufMemReq.size;
+    // タイムラインセマフォを有効にする
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    devCreateInfo.pNext = &timelineSemaphoreFeatures;
 
-    suitableMemoryTypeFound = false;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if (indexBufMemReq.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
-            indexBufMemAllocInfo.memoryTypeIndex = i;
-            suitableMemoryTypeFound = true;
-            break;
-        }
+    // パイプライン統計クエリを使う場合は機能を有効にする
+    bool pipelineStatsEnabled = options.pipelineStats && PipelineStats::isSupported(physicalDevice);
+    if (options.pipelineStats && !pipelineStatsEnabled) {
+        std::cerr << "このデバイスはパイプライン統計クエリに対応していません。" << std::endl;
     }
-    if (!suitableMemoryTypeFound) {
-        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
-        return -1;
-    }
-
-    vk::UniqueDeviceMemory indexBufMemory = device->allocateMemoryUnique(indexBufMemAllocInfo);
-
-    device->bindBufferMemory(indexBuf.get(), indexBufMemory.get(), 0);
-
-    {
-        vk::BufferCreateInfo stagingBufferCreateInfo;
-        stagingBufferCreateInfo.size = sizeof(uint16_t) * indices.size();
-        stagingBufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
-        stagingBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
-
-        vk::UniqueBuffer stagingBuf = device->createBufferUnique(stagingBufferCreateInfo);
-
-        vk::MemoryRequirements stagingBufMemReq = device->getBufferMemoryRequirements(stagingBuf.get());
-
-        vk::MemoryAllocateInfo stagingBufMemAllocInfo;
-        stagingBufMemAllocInfo.allocationSize = stagingBufMemReq.size;
-
-        suitableMemoryTypeFound = false;
-        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-            if (stagingBufMemReq.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
-                stagingBufMemAllocInfo.memoryTypeIndex = i;
-                suitableMemoryTypeFound = true;
-                break;
-            }
-        }
-        if (!suitableMemoryTypeFound) {
-            std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
-            return -1;
-        }
-
-        vk::UniqueDeviceMemory stagingBufMemory = device->allocateMemoryUnique(stagingBufMemAllocInfo);
-
-        device->bindBufferMemory(stagingBuf.get(), stagingBufMemory.get(), 0);
-
-        void *pStagingBufMem = device->mapMemory(stagingBufMemory.get(), 0, sizeof(uint16_t) * indices.size());
-
-        std::memcpy(pStagingBufMem, indices.data(), sizeof(uint16_t) * indices.size());
-
-        vk::MappedMemoryRange flushMemoryRange;
-        flushMemoryRange.memory = stagingBufMemory.get();
-        flushMemoryRange.offset = 0;
-        flushMemoryRange.size = sizeof(uint16_t) * indices.size();
-
-        device->flushMappedMemoryRanges({flushMemoryRange});
-
-        device->unmapMemory(stagingBufMemory.get());
-
-        vk::CommandPoolCreateInfo tmpCmdPoolCreateInfo;
-        tmpCmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-        tmpCmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
-        vk::UniqueCommandPool tmpCmdPool = device->createCommandPoolUnique(tmpCmdPoolCreateInfo);
-
-        vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
-        tmpCmdBufAllocInfo.commandPool = tmpCmdPool.get();
-        tmpCmdBufAllocInfo.commandBufferCount = 1;
-        tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-        std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
-
-        vk::BufferCopy bufCopy;
-        bufCopy.srcOffset = 0;
-        bufCopy.dstOffset = 0;
-        bufCopy.size = sizeof(uint16_t) * indices.size();
-
-        vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-        tmpCmdBufs[0]->begin(cmdBeginInfo);
-        tmpCmdBufs[0]->copyBuffer(stagingBuf.get(), indexBuf.get(), {bufCopy});
-        tmpCmdBufs[0]->end();
+    vk::PhysicalDeviceFeatures enabledFeatures;
+    enabledFeatures.pipelineStatisticsQuery = pipelineStatsEnabled;
+    devCreateInfo.pEnabledFeatures = &enabledFeatures;
 
-        vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
-        vk::SubmitInfo submitInfo;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = submitCmdBuf;
+    vk::UniqueDevice device = physicalDevice.createDeviceUnique(devCreateInfo);
 
-        graphicsQueue.submit({submitInfo});
-        graphicsQueue.waitIdle();
+    vk::Queue graphicsQueue = device->getQueue(graphicsQueueFamilyIndex, 0);
+    vk::Queue transferQueue = useTransferQueue ? device->getQueue(transferQueueFamilyIndex, 0) : graphicsQueue;
+    if (!useTransferQueue) {
+        transferQueueFamilyIndex = graphicsQueueFamilyIndex;
     }
+    std::cout << "upload queue family: " << transferQueueFamilyIndex << (useTransferQueue ? " (transfer only)" : " (graphics)") << std::endl;
+
+    // バッファのメモリはブロック単位で確保したデバイスメモリから切り出す
+    //  ヒープの使用量が予算に近づいたら、デバイスローカルのメモリの代わりにホストのメモリへ割り当てる
+    MemoryBudget memoryBudget(physicalDevice, memoryBudgetEnabled);
+    DeviceAllocator allocator(physicalDevice, device.get());
+    allocator.setBudget(&memoryBudget);
+    // ドライバが専用のメモリを望むリソースと閾値を超えるリソースは、ブロックから切り出さずに専用に確保する
+    allocator.configureDedicatedAllocation(DeviceAllocator::isDedicatedAllocationSupported(physicalDevice),
+                                           options.dedicatedThreshold > 0 ? options.dedicatedThreshold : allocator.getDedicatedThreshold());
+
+    // アップロードに使う一時的なステージングバッファは、使い終わったらプールへ戻して再利用する
+    BufferPool bufferPool(allocator);
+
+    // 起動時のアップロードをまとめるコンテキスト (コマンドバッファの完了をスケジューラの破棄時に待つため、スケジューラより先に作成する)
+    UploadContext uploadContext(bufferPool, device.get(), transferQueueFamilyIndex, graphicsQueueFamilyIndex);
+
+    // 静的シーンモードのコマンドバッファのプール
+    //  再作成時に破棄を遅らせたコマンドバッファを、途中で return してもスケジューラの破棄時に解放できるよう、スケジューラより先に作成する
+    vk::CommandPoolCreateInfo staticCmdPoolCreateInfo;
+    staticCmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
+    vk::UniqueCommandPool staticCmdPool = device->createCommandPoolUnique(staticCmdPoolCreateInfo);
+
+    // GPUの処理完了をタイムライン値で管理するスケジューラ
+    FrameScheduler scheduler(device.get());
+    // 転送キュー用のスケジューラ (キューごとにシグナルの順序が決まるため、グラフィックスキューとはタイムラインを分ける)
+    FrameScheduler transferScheduler(device.get());
+
+    // 頂点とインデックスは1つのデバイスローカルのバッファに詰めて格納し、メッシュはオフセットで指す
+    GeometryArena geometryArena(allocator, sizeof(Vertex), vertices.size(), indices.size());
+    GeometryMesh quadMesh = geometryArena.addMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+
+    // 頂点とインデックスのコピーを1つのステージングバッファと1つのコマンドバッファにまとめ、1回の投入で転送する
+    //  転送キューでコピーした場合は、グラフィックスキューが転送の完了をセマフォで待って所有権を受け取る
+    //  CPUは完了を待たずに準備を続け、完了するまでは描画の投入が頂点入力の段階でアップロードを待つ
+    //  UMAでバッファのメモリがホストから書き込める場合は、ステージングもコピーもせずに直接書き込む
+    geometryArena.stageUploads(uploadContext);
+    UploadFuture geometryUpload = uploadContext.submitWithHandoff(transferScheduler, transferQueue, scheduler, graphicsQueue);
+    std::cout << "geometry upload: " << (uploadContext.stats().directUploads > 0 ? "direct write" : "staging copy")
+              << (isUnifiedMemory(allocator.memoryProperties()) ? " (unified memory)" : "") << std::endl;
 
     std::vector<vk::SurfaceFormatKHR> surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
     std::vector<vk::PresentModeKHR> surfacePresentModes = physicalDevice.getSurfacePresentModesKHR(surface.get());
 
-    vk::SurfaceFormatKHR swapchainFormat = surfaceFormats[0];
-    vk::PresentModeKHR swapchainPresentMode = surfacePresentModes[0];
+    vk::SurfaceFormatKHR swapchainFormat = selectSurfaceFormat(surfaceFormats);
+    vk::PresentModeKHR swapchainPresentMode = selectPresentMode(surfacePresentModes, options.presentModePolicy);
 
     vk::AttachmentDescription attachments[1];
     attachments[0].format = swapchainFormat.format;
@@ -377,23 +242,18 @@ int StagingBuffer::execute() {
 
     vk::UniqueRenderPass renderpass = device->createRenderPassUnique(renderpassCreateInfo);
 
-    vk::Viewport viewports[1];
-    viewports[0].x = 0.0;
-    viewports[0].y = 0.0;
-    viewports[0].minDepth = 0.0;
-    viewports[0].maxDepth = 1.0;
-    viewports[0].width = screenWidth;
-    viewports[0].height = screenHeight;
-
-    vk::Rect2D scissors[1];
-    scissors[0].offset = vk::Offset2D{0, 0};
-    scissors[0].extent = vk::Extent2D{screenWidth, screenHeight};
+    // 現在のスワップチェーンのサイズ (作り直すたびに更新し、ビューポート・シザー・描画範囲に使う)
+    vk::Extent2D swapchainExtent;
 
+    // ビューポートとシザーは記録時にスワップチェーンのサイズで設定する (作り直してもパイプラインはそのまま使える)
     vk::PipelineViewportStateCreateInfo viewportState;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = viewports;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = scissors;
+
+    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.dynamicStateCount = std::size(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates;
 
     vk::VertexInputBindingDescription vertexBindingDescription[1];
     vertexBindingDescription[0].binding = 0;
@@ -484,6 +344,7 @@ int StagingBuffer::execute() {
 
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
     pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
     pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
     pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
     pipelineCreateInfo.pRasterizationState = &rasterizer;
@@ -497,33 +358,144 @@ int StagingBuffer::execute() {
 
     vk::UniquePipeline pipeline = device->createGraphicsPipelineUnique(nullptr, pipelineCreateInfo).value;
 
+    // 描画に使う頂点バッファ (--dynamic-geometry ではフレームごとにアップロードリングの領域へ切り替える)
+    vk::Buffer drawVertexBuf = geometryArena.buffer();
+    vk::DeviceSize drawVertexOffset = 0;
+    int32_t drawVertexBase = quadMesh.vertexOffset;
+    // --dynamic-geometry で毎フレーム書き込む頂点
+    std::vector<Vertex> dynamicVertices(vertices.size());
+
+    // パイプラインとバッファをバインドし、四角形の描画を drawCount 回記録する
+    //  gpuTimer, pipelineStats を指定した場合は描画ごとのGPU時間とパイプライン統計を計測する
+    auto recordDraws = [&](vk::CommandBuffer cmdBuf, uint32_t drawCount, GpuTimer *gpuTimer, PipelineStats *pipelineStats) {
+        // デバイスローカルにコピー後もステージングバッファに格納した時と同じ方法で描画する
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        cmdBuf.setViewport(0, {vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), 0.0f, 1.0f)});
+        cmdBuf.setScissor(0, {vk::Rect2D({0, 0}, swapchainExtent)});
+        cmdBuf.bindVertexBuffers(0, {drawVertexBuf}, {drawVertexOffset});
+        cmdBuf.bindIndexBuffer(geometryArena.buffer(), geometryArena.indexRegionOffset(), geometryArena.indexType());
+        for (uint32_t i = 0; i < drawCount; i++) {
+            uint32_t drawScope = gpuTimer ? gpuTimer->beginScope(cmdBuf, "draw") : UINT32_MAX;
+            uint32_t drawStatsScope = pipelineStats ? pipelineStats->beginScope(cmdBuf, "draw") : UINT32_MAX;
+            cmdBuf.drawIndexed(quadMesh.indexCount, 1, quadMesh.firstIndex, drawVertexBase, 0);
+            if (pipelineStats) {
+                pipelineStats->endScope(cmdBuf, drawStatsScope);
+            }
+            if (gpuTimer) {
+                gpuTimer->endScope(cmdBuf, drawScope);
+            }
+        }
+    };
+
+    // 1フレーム分の描画コマンドを記録する
+    //  recordWorkers を指定した場合は描画をワーカーで分担してセカンダリコマンドバッファに記録し、
+    //  プライマリコマンドバッファからは executeCommands() で実行する
+    //  gpuTimer を指定した場合はレンダーパス全体と(メインスレッドで記録する場合は)描画ごとのGPU時間を計測する
+    //  pipelineStats を指定した場合は(メインスレッドで記録する場合のみ)描画ごとのパイプライン統計を計測する
+    auto recordDrawCommands = [&](vk::CommandBuffer cmdBuf, vk::Framebuffer framebuf, RecordWorkerPool *recordWorkers, uint32_t slotIndex,
+                                  GpuTimer *gpuTimer, PipelineStats *pipelineStats) {
+        vk::CommandBufferBeginInfo cmdBeginInfo;
+        cmdBuf.begin(cmdBeginInfo);
+        if (gpuTimer) {
+            gpuTimer->beginFrame(cmdBuf, slotIndex);
+        }
+        if (pipelineStats) {
+            pipelineStats->beginFrame(cmdBuf, slotIndex);
+        }
+
+        vk::ClearValue clearVal[1];
+        clearVal[0].color.float32[0] = 0.0f;
+        clearVal[0].color.float32[1] = 0.0f;
+        clearVal[0].color.float32[2] = 0.0f;
+        clearVal[0].color.float32[3] = 1.0f;
+
+        vk::RenderPassBeginInfo renderpassBeginInfo;
+        renderpassBeginInfo.renderPass = renderpass.get();
+        renderpassBeginInfo.framebuffer = framebuf;
+        renderpassBeginInfo.renderArea = vk::Rect2D({0, 0}, swapchainExtent);
+        renderpassBeginInfo.clearValueCount = 1;
+        renderpassBeginInfo.pClearValues = clearVal;
+
+        uint32_t renderPassScope = gpuTimer ? gpuTimer->beginScope(cmdBuf, "render pass") : UINT32_MAX;
+
+        if (recordWorkers) {
+            cmdBuf.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+
+            vk::CommandBufferInheritanceInfo inheritanceInfo;
+            inheritanceInfo.renderPass = renderpass.get();
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = framebuf;
+
+            uint32_t workerCount = recordWorkers->size();
+            std::vector<vk::CommandBuffer> secondaryCmdBufs = recordWorkers->record(slotIndex, inheritanceInfo,
+                [&](uint32_t workerIndex, vk::CommandBuffer secondaryCmdBuf) {
+                    // 描画を均等に分割する
+                    uint32_t firstDraw = static_cast<uint64_t>(options.drawCount) * workerIndex / workerCount;
+                    uint32_t lastDraw = static_cast<uint64_t>(options.drawCount) * (workerIndex + 1) / workerCount;
+                    recordDraws(secondaryCmdBuf, lastDraw - firstDraw, nullptr, nullptr);
+                });
+
+            cmdBuf.executeCommands(secondaryCmdBufs);
+        } else {
+            cmdBuf.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+            recordDraws(cmdBuf, options.drawCount, gpuTimer, pipelineStats);
+        }
+
+        cmdBuf.endRenderPass();
+        if (gpuTimer) {
+            gpuTimer->endScope(cmdBuf, renderPassScope);
+        }
+
+        cmdBuf.end();
+    };
+
+    // 静的シーンモード用: スワップチェーン画像(フレームバッファ)ごとに一度だけ記録するコマンドバッファ
+    //  (プールはスケジューラより先に作成してある)
+    std::vector<vk::UniqueCommandBuffer> staticCmdBufs;
+
+    // スワップチェーン画像ごとの最後に投入した時のタイムライン値
+    std::vector<uint64_t> imageTimelineValues;
+
     vk::UniqueSwapchainKHR swapchain;
     std::vector<vk::Image> swapchainImages;
     std::vector<vk::UniqueImageView> swapchainImageViews;
     std::vector<vk::UniqueFramebuffer> swapchainFramebufs;
+    // 描画完了のセマフォはプレゼンテーションが待ち終わるまで再びシグナルできないため、フレームスロットではなく画像ごとに持つ
+    //  (画像はプレゼンテーションが終わるまで再取得されない)
+    std::vector<vk::UniqueSemaphore> imgRenderedSemaphores;
 
     auto recreateSwapchain = [&]() {
-        swapchainFramebufs.clear();
-        swapchainImageViews.clear();
+        // 古いスワップチェーンやフレームバッファは投入済みのフレームがまだ使っている可能性がある
+        // GPUの完了を待って止まる代わりに、投入済みの全フレームが完了するまで破棄を遅らせる
+        uint64_t retireValue = scheduler.submittedValue();
+        scheduler.destroyAfter(retireValue, std::move(staticCmdBufs));
+        scheduler.destroyAfter(retireValue, std::move(swapchainFramebufs));
+        scheduler.destroyAfter(retireValue, std::move(swapchainImageViews));
+        scheduler.destroyAfter(retireValue, std::move(imgRenderedSemaphores));
         swapchainImages.clear();
-        swapchain.reset();
+
+        // 古いスワップチェーンを渡すと、ドライバは表示中の画像やメモリを新しいスワップチェーンに引き継げる
+        vk::UniqueSwapchainKHR oldSwapchain = std::move(swapchain);
 
         vk::SurfaceCapabilitiesKHR surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface.get());
+        swapchainExtent = sampleWindow.extent(surfaceCapabilities);
 
         vk::SwapchainCreateInfoKHR swapchainCreateInfo;
         swapchainCreateInfo.surface = surface.get();
         swapchainCreateInfo.minImageCount = surfaceCapabilities.minImageCount + 1;
         swapchainCreateInfo.imageFormat = swapchainFormat.format;
         swapchainCreateInfo.imageColorSpace = swapchainFormat.colorSpace;
-        swapchainCreateInfo.imageExtent = surfaceCapabilities.currentExtent;
+        swapchainCreateInfo.imageExtent = swapchainExtent;
         swapchainCreateInfo.imageArrayLayers = 1;
         swapchainCreateInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
         swapchainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
         swapchainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
         swapchainCreateInfo.presentMode = swapchainPresentMode;
         swapchainCreateInfo.clipped = VK_TRUE;
+        swapchainCreateInfo.oldSwapchain = oldSwapchain.get();
 
         swapchain = device->createSwapchainKHRUnique(swapchainCreateInfo);
+        scheduler.destroyAfter(retireValue, std::move(oldSwapchain));
 
         swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
 
@@ -547,6 +519,11 @@ int StagingBuffer::execute() {
             swapchainImageViews[i] = device->createImageViewUnique(imgViewCreateInfo);
         }
 
+        imgRenderedSemaphores.resize(swapchainImages.size());
+        for (size_t i = 0; i < swapchainImages.size(); i++) {
+            imgRenderedSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+        }
+
         swapchainFramebufs.resize(swapchainImages.size());
 
         for (size_t i = 0; i < swapchainImages.size(); i++) {
@@ -554,8 +531,8 @@ int StagingBuffer::execute() {
             frameBufAttachments[0] = swapchainImageViews[i].get();
 
             vk::FramebufferCreateInfo frameBufCreateInfo;
-            frameBufCreateInfo.width = surfaceCapabilities.currentExtent.width;
-            frameBufCreateInfo.height = surfaceCapabilities.currentExtent.height;
+            frameBufCreateInfo.width = swapchainExtent.width;
+            frameBufCreateInfo.height = swapchainExtent.height;
             frameBufCreateInfo.layers = 1;
             frameBufCreateInfo.renderPass = renderpass.get();
             frameBufCreateInfo.attachmentCount = 1;
@@ -563,97 +540,166 @@ int StagingBuffer::execute() {
 
             swapchainFramebufs[i] = device->createFramebufferUnique(frameBufCreateInfo);
         }
-    };
 
-    recreateSwapchain();
+        imageTimelineValues.assign(swapchainImages.size(), 0);
 
-    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
-    cmdPoolCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    vk::UniqueCommandPool cmdPool = device->createCommandPoolUnique(cmdPoolCreateInfo);
+        if (options.staticScene) {
+            // フレームバッファが作り直された時だけコマンドを記録し直す
+            vk::CommandBufferAllocateInfo staticCmdBufAllocInfo;
+            staticCmdBufAllocInfo.commandPool = staticCmdPool.get();
+            staticCmdBufAllocInfo.commandBufferCount = swapchainFramebufs.size();
+            staticCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+            staticCmdBufs = device->allocateCommandBuffersUnique(staticCmdBufAllocInfo);
 
-    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
-    cmdBufAllocInfo.commandPool = cmdPool.get();
-    cmdBufAllocInfo.commandBufferCount = 1;
-    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-    std::vector<vk::UniqueCommandBuffer> cmdBufs = device->allocateCommandBuffersUnique(cmdBufAllocInfo);
-
-    vk::SemaphoreCreateInfo semaphoreCreateInfo;
-
-    vk::UniqueSemaphore swapchainImgSemaphore, imgRenderedSemaphore;
-    swapchainImgSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
-    imgRenderedSemaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
+            for (size_t i = 0; i < swapchainFramebufs.size(); i++) {
+                recordDrawCommands(staticCmdBufs[i].get(), swapchainFramebufs[i].get(), nullptr, 0, nullptr, nullptr);
+            }
+        }
+    };
 
-    vk::FenceCreateInfo fenceCreateInfo;
-    fenceCreateInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+    recreateSwapchain();
 
-    vk::UniqueFence imgRenderedFence = device->createFenceUnique(fenceCreateInfo);
+    // フレームスロットのリング (スロットごとにコマンドバッファとセマフォを持つ)
+    FrameRing frameRing(device.get(), scheduler, graphicsQueueFamilyIndex, options.framesInFlight);
+    FrameCounter frameCounter;
+    // 処理段階ごとのCPU時間 (終了時に分布を出力する)
+    FrameProfiler profiler;
+    // タイムスタンプクエリによるGPU時間 (--gpu-timestamps 指定時のみ。静的シーンモードでは毎フレームの記録がないため計測しない)
+    GpuTimer gpuTimer(device.get(), physicalDevice, graphicsQueueFamilyIndex, options.gpuTimestamps && !options.staticScene, frameRing.size());
+    // パイプライン統計クエリ (--stats 指定時のみ。静的シーンモードでは計測しない)
+    PipelineStats pipelineStats(device.get(), pipelineStatsEnabled && !options.staticScene, frameRing.size());
+
+    // セカンダリコマンドバッファを並列に記録するワーカー (静的シーンモードでは毎フレームの記録がないため使わない)
+    std::unique_ptr<RecordWorkerPool> recordWorkers;
+    if (options.recordThreads > 0 && !options.staticScene) {
+        recordWorkers = std::make_unique<RecordWorkerPool>(device.get(), graphicsQueueFamilyIndex, options.recordThreads, frameRing.size());
+    }
+    // 毎フレーム変化する頂点データを書き込むアップロードリング (静的シーンモードでは使わない)
+    std::unique_ptr<UploadRing> uploadRing;
+    if (options.dynamicGeometry && !options.staticScene) {
+        uploadRing = std::make_unique<UploadRing>(allocator, frameRing.size(), 64 * 1024, vk::BufferUsageFlagBits::eVertexBuffer);
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    std::cout << "draws: " << options.drawCount << ", record threads: " << (recordWorkers ? recordWorkers->size() : 0) << std::endl;
+
+    while (!sampleWindow.shouldClose(frameCounter.count())) {
+        profiler.begin(FrameStage::PollEvents);
+        sampleWindow.pollEvents();
+        profiler.end(FrameStage::PollEvents);
+
+        // 次のフレームスロットを取得する (スロットの前回の描画が終わるまで待つ)
+        profiler.begin(FrameStage::WaitFrame);
+        FrameSlot& frame = frameRing.acquire();
+        profiler.end(FrameStage::WaitFrame);
+        // 完了したフレームに紐づく遅延処理を実行する (完了したアップロードのステージングバッファもここでプールへ戻る)
+        scheduler.retire();
+        transferScheduler.retire();
+        // スロットの前回の投入分が完了したため、アップロードリングの領域を再利用できる
+        if (uploadRing) {
+            uploadRing->beginFrame(frameRing.currentIndex());
+        }
+        // 予算は他のプロセスの使用状況でも変わるため、定期的に取得し直す
+        if (frameCounter.count() % 60 == 0) {
+            memoryBudget.update();
+        }
 
-        device->waitForFences({imgRenderedFence.get()}, VK_TRUE, UINT64_MAX);
+        // リサイズ負荷の計測用: 一定フレームごとに表示サイズを変えてスワップチェーンを作り直す
+        if (sampleWindow.churnResize(frameCounter.count())) {
+            recreateSwapchain();
+        }
 
-        vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, swapchainImgSemaphore.get());
-        if (acquireImgResult.result == vk::Result::eSuboptimalKHR || acquireImgResult.result == vk::Result::eErrorOutOfDateKHR) {
+        frameCounter.markAcquire();
+        vk::Result acquireResult;
+        uint32_t imgIndex = 0;
+        profiler.begin(FrameStage::Acquire);
+        try {
+            vk::ResultValue acquireImgResult = device->acquireNextImageKHR(swapchain.get(), 1'000'000'000, frame.swapchainImgSemaphore.get());
+            acquireResult = acquireImgResult.result;
+            imgIndex = acquireImgResult.value;
+        } catch (const vk::OutOfDateKHRError&) {
+            acquireResult = vk::Result::eErrorOutOfDateKHR;
+        }
+        profiler.end(FrameStage::Acquire);
+        if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+            // 画像を取得できていないため、このフレームは描画せずに作り直す
             std::cerr << "スワップチェーンを再作成します。" << std::endl;
             recreateSwapchain();
             continue;
         }
-        if (acquireImgResult.result != vk::Result::eSuccess) {
+        if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR) {
             std::cerr << "次フレームの取得に失敗しました。" << std::endl;
             return -1;
         }
-        device->resetFences({imgRenderedFence.get()});
-
-        uint32_t imgIndex = acquireImgResult.value;
-
-        cmdBufs[0]->reset();
-
-        vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBufs[0]->begin(cmdBeginInfo);
-
-        vk::ClearValue clearVal[1];
-        clearVal[0].color.float32[0] = 0.0f;
-        clearVal[0].color.float32[1] = 0.0f;
-        clearVal[0].color.float32[2] = 0.0f;
-        clearVal[0].color.float32[3] = 1.0f;
 
-        vk::RenderPassBeginInfo renderpassBeginInfo;
-        renderpassBeginInfo.renderPass = renderpass.get();
-        renderpassBeginInfo.framebuffer = swapchainFramebufs[imgIndex].get();
-        renderpassBeginInfo.renderArea = vk::Rect2D({0, 0}, {screenWidth, screenHeight});
-        renderpassBeginInfo.clearValueCount = 1;
-        renderpassBeginInfo.pClearValues = clearVal;
-
-        cmdBufs[0]->beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
-
-        // デバイスローカルにコピー後もステージングバッファに格納した時と同じ方法で描画する
-        cmdBufs[0]->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
-        cmdBufs[0]->bindVertexBuffers(0, {vertexBuf.get()}, {0});
-        cmdBufs[0]->bindIndexBuffer(indexBuf.get(), 0, vk::IndexType::eUint16);
-        cmdBufs[0]->drawIndexed(indices.size(), 1, 0, 0, 0);
+        if (options.staticScene) {
+            // 同じ画像のコマンドバッファがまだ実行中の場合は再投入できないため完了を待つ
+            scheduler.wait(imageTimelineValues[imgIndex]);
+        }
 
-        cmdBufs[0]->endRenderPass();
+        frameCounter.markRecordStart();
+
+        profiler.begin(FrameStage::Record);
+        vk::CommandBuffer drawCmdBuf;
+        if (options.staticScene) {
+            // 事前に記録したコマンドバッファを投入するだけで、毎フレームの記録は行わない
+            drawCmdBuf = staticCmdBufs[imgIndex].get();
+        } else {
+            if (uploadRing) {
+                // 四角形を回転させた頂点を今フレームの領域に書き込み、頂点バッファとして使う
+                UploadRing::Span vertexSpan = uploadRing->allocate(sizeof(Vertex) * vertices.size(), alignof(Vertex));
+                if (vertexSpan.data) {
+                    // マップしたメモリ上で書き換えず、回転させた頂点をまとめて書き込む
+                    float angle = frameCounter.count() * 0.01f;
+                    for (size_t i = 0; i < vertices.size(); i++) {
+                        dynamicVertices[i] = vertices[i];
+                        dynamicVertices[i].pos.x = vertices[i].pos.x * std::cos(angle) - vertices[i].pos.y * std::sin(angle);
+                        dynamicVertices[i].pos.y = vertices[i].pos.x * std::sin(angle) + vertices[i].pos.y * std::cos(angle);
+                    }
+                    copyToMapped(vertexSpan.data, dynamicVertices.data(), sizeof(Vertex) * dynamicVertices.size());
+                    uploadRing->flush();
+
+                    drawVertexBuf = vertexSpan.buffer;
+                    drawVertexOffset = vertexSpan.offset;
+                    drawVertexBase = 0;
+                } else {
+                    // 領域が足りない場合はジオメトリ領域の頂点で描画する
+                    drawVertexBuf = geometryArena.buffer();
+                    drawVertexOffset = 0;
+                    drawVertexBase = quadMesh.vertexOffset;
+                }
+            }
 
-        cmdBufs[0]->end();
+            frame.cmdBuf->reset();
+            recordDrawCommands(frame.cmdBuf.get(), swapchainFramebufs[imgIndex].get(), recordWorkers.get(), frameRing.currentIndex(), &gpuTimer, &pipelineStats);
+            drawCmdBuf = frame.cmdBuf.get();
+        }
+        profiler.end(FrameStage::Record);
 
-        vk::CommandBuffer submitCmdBuf[1] = {cmdBufs[0].get()};
+        vk::CommandBuffer submitCmdBuf[1] = {drawCmdBuf};
         vk::SubmitInfo submitInfo;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = submitCmdBuf;
 
-        vk::Semaphore renderwaitSemaphores[] = {swapchainImgSemaphore.get()};
+        vk::Semaphore renderwaitSemaphores[] = {frame.swapchainImgSemaphore.get()};
         vk::PipelineStageFlags renderwaitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = renderwaitSemaphores;
         submitInfo.pWaitDstStageMask = renderwaitStages;
 
-        vk::Semaphore renderSignalSemaphores[] = {imgRenderedSemaphore.get()};
+        vk::Semaphore renderSignalSemaphores[] = {imgRenderedSemaphores[imgIndex].get()};
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = renderSignalSemaphores;
 
-        graphicsQueue.submit({submitInfo}, imgRenderedFence.get());
+        profiler.begin(FrameStage::Submit);
+        std::vector<FrameScheduler::TimelineWait> uploadWaits;
+        if (!geometryUpload.isReady()) {
+            uploadWaits.push_back(geometryUpload.asWait(vk::PipelineStageFlagBits::eVertexInput));
+        }
+        frame.timelineValue = scheduler.submit(graphicsQueue, submitInfo, uploadWaits);
+        profiler.end(FrameStage::Submit);
+        imageTimelineValues[imgIndex] = frame.timelineValue;
+
+        frameCounter.markSubmitted();
 
         vk::PresentInfoKHR presentInfo;
 
@@ -664,14 +710,43 @@ int StagingBuffer::execute() {
         presentInfo.pSwapchains = presentSwapchains.begin();
         presentInfo.pImageIndices = imgIndices.begin();
 
-        vk::Semaphore presenWaitSemaphores[] = {imgRenderedSemaphore.get()};
+        vk::Semaphore presenWaitSemaphores[] = {imgRenderedSemaphores[imgIndex].get()};
         presentInfo.waitSemaphoreCount = 1;
         presentInfo.pWaitSemaphores = presenWaitSemaphores;
 
-        graphicsQueue.presentKHR(presentInfo);
+        // SUBOPTIMALの場合は取得済みの画像を表示してからスワップチェーンを作り直す
+        bool needsRecreate = acquireResult == vk::Result::eSuboptimalKHR;
+        profiler.begin(FrameStage::Present);
+        try {
+            needsRecreate |= graphicsQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR;
+        } catch (const vk::OutOfDateKHRError&) {
+            needsRecreate = true;
+        }
+        profiler.end(FrameStage::Present);
+
+        frameCounter.tick();
+
+        if (needsRecreate) {
+            std::cerr << "スワップチェーンを再作成します。" << std::endl;
+            recreateSwapchain();
+        }
     }
 
     graphicsQueue.waitIdle();
-    glfwTerminate();
+    // 破棄を遅らせていたオブジェクトを、参照先(コマンドプールなど)より先に破棄する
+    scheduler.retire();
+    frameCounter.report(std::cout);
+    profiler.report(std::cout);
+    allocator.report(std::cout);
+    bufferPool.report(std::cout);
+    uploadContext.report(std::cout);
+    geometryArena.report(std::cout);
+    memoryBudget.update();
+    memoryBudget.report(std::cout);
+    if (uploadRing) {
+        uploadRing->report(std::cout);
+    }
+    gpuTimer.report(std::cout);
+    pipelineStats.report(std::cout);
     return 0;
 }
\ No newline at end of file
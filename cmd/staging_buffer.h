@@ -1,6 +1,7 @@
 #pragma once
 
 #include "command.h"
+#include "sample_options.h"
 
 // MEMO:
 //  - デバイスから高速にアクセスできるメモリ(ホスト不可視、デバイス可視)
@@ -14,8 +15,11 @@
 
 class StagingBuffer : public Command {
 public:
-    StagingBuffer() {};
+    StagingBuffer(const SampleOptions& options) : options(options) {};
     ~StagingBuffer() override {};
 
     int execute() override;
+
+private:
+    SampleOptions options;
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "staging_fill_bench.h"
+#include "bench_context.h"
+#include "buffer_pool.h"
+#include "device_allocator.h"
+#include "fill_worker_pool.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 読み込んだままの頂点 (32バイト)
+struct SourceVertex {
+    float pos[3];
+    float normal[3];
+    float uv[2];
+};
+
+// アップロードする量子化済みの頂点 (16バイト)
+//  位置は [-1, 1] を int16 の SNORM、法線は int8 の SNORM、UVは uint16 の UNORM にする
+struct PackedVertex {
+    int16_t pos[4];
+    int8_t normal[4];
+    uint16_t uv[2];
+};
+
+int16_t toSnorm16(float v) {
+    return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+int8_t toSnorm8(float v) {
+    return static_cast<int8_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 127.0f));
+}
+
+uint16_t toUnorm16(float v) {
+    return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+}
+
+int StagingFillBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    // 書き込むサイズ (MiB)
+    vk::DeviceSize fillSize = vk::DeviceSize(options.count > 0 ? options.count : 256) * 1024 * 1024;
+    size_t vertexCount = fillSize / sizeof(PackedVertex);
+
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), ctx.getDevice());
+    BufferPool bufferPool(allocator);
+    PooledBuffer stagingBuf = bufferPool.acquire(vk::BufferUsageFlagBits::eTransferSrc, fillSize);
+
+    std::vector<char> copySource(fillSize, 0x5a);
+    std::vector<SourceVertex> sourceVertices(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        float t = static_cast<float>(i) * 0.001f;
+        sourceVertices[i] = SourceVertex{{std::sin(t), std::cos(t), std::sin(t * 0.5f)},
+                                         {0.0f, std::cos(t), std::sin(t)},
+                                         {std::fmod(t, 1.0f), std::fmod(t * 0.5f, 1.0f)}};
+    }
+
+    // 範囲内の頂点を量子化して書き込む (範囲は PackedVertex の境界で分けられる)
+    FillWorkerPool::Region quantizeRegion;
+    quantizeRegion.stagingOffset = 0;
+    quantizeRegion.size = sizeof(PackedVertex) * vertexCount;
+    quantizeRegion.elementSize = sizeof(PackedVertex);
+    quantizeRegion.fill = [&](void* dst, vk::DeviceSize begin, vk::DeviceSize end) {
+        PackedVertex* packed = static_cast<PackedVertex*>(dst);
+        size_t first = begin / sizeof(PackedVertex);
+        size_t last = end / sizeof(PackedVertex);
+        for (size_t i = first; i < last; i++) {
+            const SourceVertex& v = sourceVertices[i];
+            PackedVertex& p = packed[i - first];
+            p.pos[0] = toSnorm16(v.pos[0]);
+            p.pos[1] = toSnorm16(v.pos[1]);
+            p.pos[2] = toSnorm16(v.pos[2]);
+            p.pos[3] = 32767;
+            p.normal[0] = toSnorm8(v.normal[0]);
+            p.normal[1] = toSnorm8(v.normal[1]);
+            p.normal[2] = toSnorm8(v.normal[2]);
+            p.normal[3] = 0;
+            p.uv[0] = toUnorm16(v.uv[0]);
+            p.uv[1] = toUnorm16(v.uv[1]);
+        }
+    };
+    std::vector<FillWorkerPool::Region> quantizeRegions = {quantizeRegion};
+    std::vector<FillWorkerPool::Region> copyRegions = {FillWorkerPool::copyRegion(0, copySource.data(), fillSize)};
+
+    std::vector<uint32_t> threadCounts;
+    uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "fill size: " << fillSize / (1024 * 1024) << " MiB (" << vertexCount << " quantized vertices)" << std::endl;
+
+    double copyBase = 0.0;
+    double quantizeBase = 0.0;
+    for (uint32_t threads : threadCounts) {
+        FillWorkerPool fillWorkers(threads);
+
+        // 1回目はページフォールトなどを含むため、2回目を計測する
+        fillWorkers.fill(stagingBuf, copyRegions);
+        Clock::time_point start = Clock::now();
+        fillWorkers.fill(stagingBuf, copyRegions);
+        double copySeconds = elapsedSeconds(start);
+
+        fillWorkers.fill(stagingBuf, quantizeRegions);
+        start = Clock::now();
+        fillWorkers.fill(stagingBuf, quantizeRegions);
+        double quantizeSeconds = elapsedSeconds(start);
+
+        if (threads == 1) {
+            copyBase = copySeconds;
+            quantizeBase = quantizeSeconds;
+        }
+
+        std::cout << threads << " thread(s): copy " << fillSize / copySeconds / 1e9 << " GB/s (" << copyBase / copySeconds << "x)"
+                  << ", quantize " << fillSize / quantizeSeconds / 1e9 << " GB/s (" << quantizeBase / quantizeSeconds << "x)" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// ステージングバッファへの書き込み(コピーと頂点データの量子化)を FillWorkerPool で1〜ハードウェアのスレッド数に分担し、
+// スレッド数ごとの書き込み速度(GB/s)を出力するベンチマーク
+class StagingFillBench : public Command {
+public:
+    StagingFillBench(const BenchOptions& options) : options(options) {};
+    ~StagingFillBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
@@ -0,0 +1,65 @@
+#include "streaming_bench.h"
+#include "bench_context.h"
+#include "device_allocator.h"
+#include "frame_scheduler.h"
+#include "memory_type.h"
+#include "streaming_uploader.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+int StreamingBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+
+    // 転送する合計サイズ (MiB)
+    vk::DeviceSize totalSize = vk::DeviceSize(options.count > 0 ? options.count : 1024) * 1024 * 1024;
+    // コピー先のバッファはこの大きさで、合計サイズに達するまで先頭から繰り返し書き込む
+    vk::DeviceSize dstSize = std::min<vk::DeviceSize>(totalSize, 256ull * 1024 * 1024);
+
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+
+    vk::BufferCreateInfo dstBufferCreateInfo;
+    dstBufferCreateInfo.size = dstSize;
+    dstBufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    dstBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    vk::UniqueBuffer dstBuf = device.createBufferUnique(dstBufferCreateInfo);
+
+    vk::MemoryRequirements dstBufMemReq = device.getBufferMemoryRequirements(dstBuf.get());
+    uint32_t dstBufMemTypeIndex = selectMemoryType(allocator.memoryProperties(), dstBufMemReq.memoryTypeBits, MemoryUsage::GpuOnly);
+    if (dstBufMemTypeIndex == UINT32_MAX) {
+        std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+        return -1;
+    }
+    DeviceAllocation dstBufMemory = allocator.allocateForBuffer(dstBuf.get(), dstBufMemTypeIndex, MemoryUsage::GpuOnly);
+
+    std::vector<char> hostData(dstSize, 0x5a);
+
+    std::cout << "total: " << totalSize / (1024 * 1024) << " MiB, destination: " << dstSize / (1024 * 1024) << " MiB, staging ring: 64 MiB" << std::endl;
+
+    for (uint32_t chunkCount : {1u, 4u}) {
+        // アップローダをスケジューラより先に作成する (コマンドバッファの破棄はスケジューラが完了を待った後)
+        StreamingUploader uploader(allocator, ctx.getQueueFamilyIndex(), 64ull * 1024 * 1024, chunkCount);
+        FrameScheduler scheduler(device);
+
+        auto start = std::chrono::steady_clock::now();
+        UploadFuture lastUpload;
+        for (vk::DeviceSize done = 0; done < totalSize; done += dstSize) {
+            vk::DeviceSize size = std::min(dstSize, totalSize - done);
+            lastUpload = uploader.upload(scheduler, ctx.getQueue(), dstBuf.get(), 0, hostData.data(), size);
+        }
+        lastUpload.wait();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << chunkCount << " chunk(s): ";
+        uploader.report(std::cout, seconds);
+    }
+
+    return 0;
+}
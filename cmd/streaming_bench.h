@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// 64MBのステージングリングを通して大きなデータをデバイスローカルのバッファへ転送し、持続的な転送速度(GB/s)を出力するベンチマーク
+//  リングを1チャンクで使う(書き込みとコピーが重ならない)場合と4チャンクに分けた場合を比較する
+class StreamingBench : public Command {
+public:
+    StreamingBench(const BenchOptions& options) : options(options) {};
+    ~StreamingBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
@@ -0,0 +1,116 @@
+#include "streaming_uploader.h"
+#include "frame_scheduler.h"
+#include "memory_type.h"
+#include "mapped_copy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+StreamingUploader::StreamingUploader(DeviceAllocator& allocator, uint32_t queueFamilyIndex, vk::DeviceSize ringSize, uint32_t chunkCount)
+    : device(allocator.getDevice()),
+      chunkBytes(0),
+      chunks(chunkCount),
+      nextChunk(0) {
+    if (chunkCount == 0) {
+        throw std::runtime_error("ステージングリングのチャンク数が 0 です。");
+    }
+    // チャンクの先頭をフラッシュの単位とコピー元のオフセットの推奨アラインメントに揃える
+    const vk::PhysicalDeviceLimits& limits = allocator.limits();
+    vk::DeviceSize alignment = std::max(limits.nonCoherentAtomSize, limits.optimalBufferCopyOffsetAlignment);
+    chunkBytes = ringSize / chunkCount / alignment * alignment;
+    if (chunkBytes == 0) {
+        throw std::runtime_error("ステージングリングが小さすぎるため、チャンクのサイズが 0 になります。");
+    }
+
+    vk::BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.size = chunkBytes * chunkCount;
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+    bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    stagingBuf = device.createBufferUnique(bufferCreateInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(stagingBuf.get());
+    uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, MemoryUsage::Upload);
+    if (memTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("ステージングリングに使えるメモリタイプが存在しません。");
+    }
+    stagingMemory = allocator.allocateForBuffer(stagingBuf.get(), memTypeIndex, MemoryUsage::Upload);
+
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    commandPool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+
+    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+    cmdBufAllocInfo.commandPool = commandPool.get();
+    cmdBufAllocInfo.commandBufferCount = chunkCount;
+    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        chunks[i].cmdBuf = std::move(cmdBufs[i]);
+    }
+}
+
+UploadFuture StreamingUploader::upload(FrameScheduler& scheduler, vk::Queue queue, vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size) {
+    const char* src = static_cast<const char*>(data);
+    uint64_t lastValue = 0;
+
+    for (vk::DeviceSize done = 0; done < size;) {
+        vk::DeviceSize copySize = std::min(chunkBytes, size - done);
+        uint32_t chunkIndex = nextChunk;
+        nextChunk = (nextChunk + 1) % chunks.size();
+        Chunk& chunk = chunks[chunkIndex];
+
+        // チャンクの前回のコピーが終わるまで待つ (リングが一周した時だけ待つことになる)
+        if (chunk.value > scheduler.completedValue()) {
+            auto stallStart = std::chrono::steady_clock::now();
+            scheduler.wait(chunk.value);
+            counters.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stallStart).count();
+        }
+
+        vk::DeviceSize chunkOffset = chunkBytes * chunkIndex;
+        copyToMapped(static_cast<char*>(stagingMemory.mapped()) + chunkOffset, src + done, copySize);
+        stagingMemory.flush(chunkOffset, copySize);
+
+        vk::CommandBuffer cmdBuf = chunk.cmdBuf.get();
+        cmdBuf.reset();
+
+        vk::CommandBufferBeginInfo cmdBeginInfo;
+        cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        cmdBuf.begin(cmdBeginInfo);
+
+        vk::BufferCopy bufCopy;
+        bufCopy.srcOffset = chunkOffset;
+        bufCopy.dstOffset = dstOffset + done;
+        bufCopy.size = copySize;
+        cmdBuf.copyBuffer(stagingBuf.get(), dst, {bufCopy});
+
+        // 後続の投入のすべての読み出しから見えるようにする
+        vk::MemoryBarrier memoryBarrier;
+        memoryBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        memoryBarrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {memoryBarrier}, {}, {});
+        cmdBuf.end();
+
+        vk::CommandBuffer submitCmdBuf[1] = {cmdBuf};
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = submitCmdBuf;
+
+        chunk.value = scheduler.submit(queue, submitInfo);
+        lastValue = chunk.value;
+
+        counters.uploadedBytes += copySize;
+        counters.chunkCount++;
+        done += copySize;
+    }
+
+    return UploadFuture(&scheduler, lastValue);
+}
+
+void StreamingUploader::report(std::ostream& os, double elapsedSeconds) const {
+    os << "streaming upload: " << counters.uploadedBytes / (1024 * 1024) << " MiB in " << counters.chunkCount << " chunks of "
+       << chunkBytes / (1024 * 1024) << " MiB, " << elapsedSeconds * 1000.0 << " ms ("
+       << (elapsedSeconds > 0.0 ? counters.uploadedBytes / elapsedSeconds / 1e9 : 0.0) << " GB/s)"
+       << ", stalled " << counters.stallSeconds * 1000.0 << " ms waiting for chunks" << std::endl;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "device_allocator.h"
+#include "upload_context.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class FrameScheduler;
+
+// ステージング用のメモリより大きなデータを、固定サイズのステージングリングを通して少しずつデバイスローカルのバッファへ転送するアップローダ
+//  リングを chunkCount 個のチャンクに分け、チャンクごとに書き込み・コピーの記録・投入を行う。
+//  GPUがチャンク i をコピーしている間にCPUはチャンク i+1 を書き込むため、書き込みとコピーが重なる。
+//  チャンクを再利用する時だけ、そのチャンクの前回のコピーの完了を待つ。
+class StreamingUploader {
+public:
+    struct Stats {
+        uint64_t uploadedBytes = 0;
+        uint64_t chunkCount = 0;      // 投入したチャンク数
+        double stallSeconds = 0.0;    // チャンクの再利用待ちでCPUが止まった時間
+    };
+
+    // ringSize のステージングバッファを chunkCount 個に分けて使う
+    //  チャンクのサイズは nonCoherentAtomSize と optimalBufferCopyOffsetAlignment の大きい方に切り下げる
+    //  chunkCount が 0 の場合、チャンクのサイズが 0 になる場合、メモリタイプが見つからない場合は std::runtime_error を投げる
+    StreamingUploader(DeviceAllocator& allocator, uint32_t queueFamilyIndex, vk::DeviceSize ringSize = 64ull * 1024 * 1024, uint32_t chunkCount = 4);
+
+    StreamingUploader(const StreamingUploader&) = delete;
+    StreamingUploader& operator=(const StreamingUploader&) = delete;
+
+    // data の size バイトを dst の dstOffset へ転送する。size はリングより大きくてよい
+    //  最後のチャンクを投入した時点で戻り、data はその時点で解放してよい
+    //  戻り値は最後のチャンク (同じキューで順に実行されるため、それ以前のチャンクも含む) の完了を表す
+    UploadFuture upload(FrameScheduler& scheduler, vk::Queue queue, vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size);
+
+    vk::DeviceSize chunkSize() const { return chunkBytes; }
+
+    Stats stats() const { return counters; }
+    // 転送量と、アップロード中の経過時間 elapsedSeconds から求めた転送速度を出力する
+    void report(std::ostream& os, double elapsedSeconds) const;
+
+private:
+    struct Chunk {
+        vk::UniqueCommandBuffer cmdBuf;
+        uint64_t value = 0;   // 前回のコピーのタイムライン値
+    };
+
+    vk::Device device;
+    vk::UniqueCommandPool commandPool;
+    DeviceAllocation stagingMemory;
+    vk::UniqueBuffer stagingBuf;  // メモリより先に破棄する
+    vk::DeviceSize chunkBytes;
+    std::vector<Chunk> chunks;
+    uint32_t nextChunk;
+
+    Stats counters;
+};
@@ -0,0 +1,196 @@
+#include "upload_batch_bench.h"
+#include "bench_context.h"
+#include "buffer_pool.h"
+#include "device_allocator.h"
+#include "frame_scheduler.h"
+#include "memory_type.h"
+#include "upload_context.h"
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+int UploadBatchBench::execute() {
+    BenchContext ctx;
+    if (!ctx.init())
+        return -1;
+
+    vk::Device device = ctx.getDevice();
+
+    std::vector<uint32_t> resourceCounts = {1, 100, 10000};
+    if (options.count > 0) {
+        resourceCounts = {options.count};
+    }
+
+    DeviceAllocator allocator(ctx.getPhysicalDevice(), device);
+    BufferPool bufferPool(allocator);
+    FrameScheduler scheduler(device);
+
+    std::cout << "unified memory: " << (isUnifiedMemory(allocator.memoryProperties()) ? "yes" : "no") << std::endl;
+
+    // 頂点バッファを想定した1KB〜16KBのデータ
+    std::vector<char> source(16 * 1024, 0x5a);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> sizeDist(1024, 16 * 1024);
+
+    for (uint32_t resourceCount : resourceCounts) {
+        std::vector<vk::DeviceSize> sizes(resourceCount);
+        for (vk::DeviceSize& size : sizes) {
+            size = sizeDist(rng) / 4 * 4;
+        }
+
+        // コピー先のデバイスローカルのバッファ (作成時間は計測に含めない)
+        std::vector<vk::UniqueBuffer> buffers(resourceCount);
+        std::vector<DeviceAllocation> memories(resourceCount);
+        for (uint32_t i = 0; i < resourceCount; i++) {
+            vk::BufferCreateInfo bufferCreateInfo;
+            bufferCreateInfo.size = sizes[i];
+            bufferCreateInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+            bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+            buffers[i] = device.createBufferUnique(bufferCreateInfo);
+
+            vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffers[i].get());
+            uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, MemoryUsage::GpuOnly);
+            if (memTypeIndex == UINT32_MAX) {
+                std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+                return -1;
+            }
+            memories[i] = allocator.allocateForBuffer(buffers[i].get(), memTypeIndex, MemoryUsage::GpuOnly);
+        }
+
+        // 従来の方法: リソースごとにステージングバッファとメモリを作成してマップし、一時的なコマンドプールで記録・投入して waitIdle() で完了を待つ
+        const vk::PhysicalDeviceMemoryProperties& memProps = allocator.memoryProperties();
+        vk::Queue queue = ctx.getQueue();
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < resourceCount; i++) {
+            vk::BufferCreateInfo stagingBufferCreateInfo;
+            stagingBufferCreateInfo.size = sizes[i];
+            stagingBufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+            stagingBufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+            vk::UniqueBuffer stagingBuf = device.createBufferUnique(stagingBufferCreateInfo);
+
+            vk::MemoryRequirements stagingBufMemReq = device.getBufferMemoryRequirements(stagingBuf.get());
+
+            vk::MemoryAllocateInfo stagingBufMemAllocInfo;
+            stagingBufMemAllocInfo.allocationSize = stagingBufMemReq.size;
+            stagingBufMemAllocInfo.memoryTypeIndex = UINT32_MAX;
+            for (uint32_t j = 0; j < memProps.memoryTypeCount; j++) {
+                if (stagingBufMemReq.memoryTypeBits & (1 << j) && (memProps.memoryTypes[j].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
+                    stagingBufMemAllocInfo.memoryTypeIndex = j;
+                    break;
+                }
+            }
+            if (stagingBufMemAllocInfo.memoryTypeIndex == UINT32_MAX) {
+                std::cerr << "適切なメモリタイプが存在しません。" << std::endl;
+                return -1;
+            }
+
+            vk::UniqueDeviceMemory stagingBufMemory = device.allocateMemoryUnique(stagingBufMemAllocInfo);
+            device.bindBufferMemory(stagingBuf.get(), stagingBufMemory.get(), 0);
+
+            void* pStagingBufMem = device.mapMemory(stagingBufMemory.get(), 0, sizes[i]);
+            std::memcpy(pStagingBufMem, source.data(), sizes[i]);
+
+            vk::MappedMemoryRange flushMemoryRange;
+            flushMemoryRange.memory = stagingBufMemory.get();
+            flushMemoryRange.offset = 0;
+            flushMemoryRange.size = VK_WHOLE_SIZE;
+            device.flushMappedMemoryRanges({flushMemoryRange});
+
+            device.unmapMemory(stagingBufMemory.get());
+
+            vk::CommandPoolCreateInfo tmpCmdPoolCreateInfo;
+            tmpCmdPoolCreateInfo.queueFamilyIndex = ctx.getQueueFamilyIndex();
+            tmpCmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+            vk::UniqueCommandPool tmpCmdPool = device.createCommandPoolUnique(tmpCmdPoolCreateInfo);
+
+            vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
+            tmpCmdBufAllocInfo.commandPool = tmpCmdPool.get();
+            tmpCmdBufAllocInfo.commandBufferCount = 1;
+            tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+            std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device.allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
+
+            vk::BufferCopy bufCopy;
+            bufCopy.srcOffset = 0;
+            bufCopy.dstOffset = 0;
+            bufCopy.size = sizes[i];
+
+            vk::CommandBufferBeginInfo cmdBeginInfo;
+            cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+            tmpCmdBufs[0]->begin(cmdBeginInfo);
+            tmpCmdBufs[0]->copyBuffer(stagingBuf.get(), buffers[i].get(), {bufCopy});
+            tmpCmdBufs[0]->end();
+
+            vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
+            vk::SubmitInfo submitInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = submitCmdBuf;
+
+            queue.submit({submitInfo});
+            queue.waitIdle();
+        }
+        double perResourceSeconds = elapsedSeconds(start);
+
+        // UploadContext で1つのステージングバッファ・1つのコマンドバッファ・1回の投入にまとめる
+        start = Clock::now();
+        {
+            UploadContext uploadContext(bufferPool, device, ctx.getQueueFamilyIndex());
+            for (uint32_t i = 0; i < resourceCount; i++) {
+                uploadContext.uploadBuffer(buffers[i].get(), 0, source.data(), sizes[i]);
+            }
+            uploadContext.submit(scheduler, ctx.getQueue()).wait();
+            scheduler.retire();
+        }
+        double batchedSeconds = elapsedSeconds(start);
+
+        // コピー先のメモリも渡し、ホストから書き込めるメモリ (UMA) ならステージングを経由せずに直接書き込む
+        //  ホストから書き込めるコピー先がなければ上の一括投入と同じ処理になるため計測しない
+        bool hostVisibleDestination = std::any_of(memories.begin(), memories.end(), [](const DeviceAllocation& memory) { return memory.mapped() != nullptr; });
+        double directSeconds = 0.0;
+        if (hostVisibleDestination) {
+            start = Clock::now();
+            {
+                UploadContext uploadContext(bufferPool, device, ctx.getQueueFamilyIndex());
+                for (uint32_t i = 0; i < resourceCount; i++) {
+                    uploadContext.uploadBuffer(buffers[i].get(), memories[i], 0, source.data(), sizes[i]);
+                }
+                uploadContext.submit(scheduler, ctx.getQueue()).wait();
+                scheduler.retire();
+            }
+            directSeconds = elapsedSeconds(start);
+        }
+
+        std::cout << resourceCount << " resources: per-resource submit " << perResourceSeconds * 1000.0 << " ms"
+                  << ", batched " << batchedSeconds * 1000.0 << " ms";
+        if (batchedSeconds > 0.0) {
+            std::cout << " (" << perResourceSeconds / batchedSeconds << "x)";
+        }
+        if (!hostVisibleDestination) {
+            std::cout << ", direct write n/a (no host-visible destination)";
+        } else {
+            std::cout << ", direct write " << directSeconds * 1000.0 << " ms";
+            if (directSeconds > 0.0) {
+                std::cout << " (" << batchedSeconds / directSeconds << "x vs batched)";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    bufferPool.report(std::cout);
+    return 0;
+}
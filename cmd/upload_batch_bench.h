@@ -0,0 +1,17 @@
+#pragma once
+
+#include "command.h"
+#include "bench_options.h"
+
+// 1, 100, 10000個のバッファの起動時アップロードについて、リソースごとに記録・投入・完了待ちする方法と
+// UploadContext で1回の投入にまとめる方法の所要時間を比較するベンチマーク
+class UploadBatchBench : public Command {
+public:
+    UploadBatchBench(const BenchOptions& options) : options(options) {};
+    ~UploadBatchBench() override {};
+
+    int execute() override;
+
+private:
+    BenchOptions options;
+};
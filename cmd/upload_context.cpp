@@ -0,0 +1,373 @@
+#include "upload_context.h"
+#include "frame_scheduler.h"
+#include "mapped_copy.h"
+
+#include <algorithm>
+
+namespace {
+
+// ステージングバッファ内の各コピー元の配置単位 (画像のコピー元はテクセルサイズと4の倍数である必要がある)
+const vk::DeviceSize stagingAlignment = 16;
+
+}
+
+UploadContext::UploadContext(BufferPool& bufferPool, vk::Device device, uint32_t queueFamilyIndex)
+    : UploadContext(bufferPool, device, queueFamilyIndex, queueFamilyIndex) {
+}
+
+UploadContext::UploadContext(BufferPool& bufferPool, vk::Device device, uint32_t transferQueueFamilyIndex, uint32_t dstQueueFamilyIndex)
+    : bufferPool(bufferPool),
+      fillWorkers(nullptr),
+      device(device),
+      transferQueueFamilyIndex(transferQueueFamilyIndex),
+      dstQueueFamilyIndex(dstQueueFamilyIndex),
+      stagingSize(0) {
+    createCommandPool(transferCommands, transferQueueFamilyIndex);
+    if (transfersOwnership()) {
+        createCommandPool(acquireCommands, dstQueueFamilyIndex);
+    }
+}
+
+uint32_t UploadContext::findTransferQueueFamily(vk::PhysicalDevice physicalDevice) {
+    std::vector<vk::QueueFamilyProperties> queueProps = physicalDevice.getQueueFamilyProperties();
+    for (size_t i = 0; i < queueProps.size(); i++) {
+        vk::QueueFlags flags = queueProps[i].queueFlags;
+        if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    return UINT32_MAX;
+}
+
+void UploadContext::createCommandPool(CommandBuffers& commandBuffers, uint32_t queueFamilyIndex) {
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    cmdPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    commandBuffers.pool = device.createCommandPoolUnique(cmdPoolCreateInfo);
+}
+
+vk::DeviceSize UploadContext::reserveStaging(vk::DeviceSize size) {
+    vk::DeviceSize offset = (stagingSize + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+    stagingSize = offset + size;
+    return offset;
+}
+
+void UploadContext::uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size) {
+    BufferCopy copy;
+    copy.dst = dst;
+    copy.dstOffset = dstOffset;
+    copy.data = data;
+    copy.size = size;
+    copy.stagingOffset = reserveStaging(size);
+    copy.elementSize = 1;
+    bufferCopies.push_back(copy);
+}
+
+void UploadContext::uploadBuffer(vk::Buffer dst, const DeviceAllocation& dstMemory, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size) {
+    if (!dstMemory.mapped()) {
+        uploadBuffer(dst, dstOffset, data, size);
+        return;
+    }
+    DirectWrite write;
+    write.memory = &dstMemory;
+    write.dstOffset = dstOffset;
+    write.data = data;
+    write.size = size;
+    directWrites.push_back(write);
+}
+
+void UploadContext::uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize elementSize, FillWorkerPool::FillFunc fill) {
+    BufferCopy copy;
+    copy.dst = dst;
+    copy.dstOffset = dstOffset;
+    copy.data = nullptr;
+    copy.size = size;
+    copy.stagingOffset = reserveStaging(size);
+    copy.elementSize = elementSize;
+    copy.fill = std::move(fill);
+    bufferCopies.push_back(std::move(copy));
+}
+
+void UploadContext::uploadImage(vk::Image dst, vk::Extent3D extent, const void* data, vk::DeviceSize size, vk::ImageLayout finalLayout) {
+    ImageCopy copy;
+    copy.dst = dst;
+    copy.extent = extent;
+    copy.data = data;
+    copy.size = size;
+    copy.stagingOffset = reserveStaging(size);
+    copy.finalLayout = finalLayout;
+    imageCopies.push_back(copy);
+}
+
+size_t UploadContext::acquireCommandBuffer(CommandBuffers& commandBuffers, const FrameScheduler& scheduler) {
+    uint64_t completed = scheduler.completedValue();
+    for (size_t i = 0; i < commandBuffers.buffers.size(); i++) {
+        if (commandBuffers.values[i] <= completed) {
+            commandBuffers.buffers[i]->reset();
+            return i;
+        }
+    }
+
+    vk::CommandBufferAllocateInfo cmdBufAllocInfo;
+    cmdBufAllocInfo.commandPool = commandBuffers.pool.get();
+    cmdBufAllocInfo.commandBufferCount = 1;
+    cmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> allocated = device.allocateCommandBuffersUnique(cmdBufAllocInfo);
+    commandBuffers.buffers.push_back(std::move(allocated[0]));
+    commandBuffers.values.push_back(0);
+    return commandBuffers.buffers.size() - 1;
+}
+
+void UploadContext::writeDirect() {
+    // 投入より前のホストの書き込みは投入したコマンドから見えるため、フラッシュだけすればよい
+    for (const DirectWrite& write : directWrites) {
+        copyToMapped(static_cast<char*>(write.memory->mapped()) + write.dstOffset, write.data, write.size);
+        write.memory->flush(write.dstOffset, write.size);
+        counters.directUploads++;
+        counters.directBytes += write.size;
+    }
+    directWrites.clear();
+}
+
+PooledBuffer UploadContext::fillStaging() {
+    // すべてのコピー元を1つのステージングバッファに詰める
+    PooledBuffer stagingBuf = bufferPool.acquire(vk::BufferUsageFlagBits::eTransferSrc, stagingSize);
+    counters.stagedUploads += bufferCopies.size() + imageCopies.size();
+    counters.stagedBytes += stagingSize;
+
+    if (fillWorkers) {
+        // ステージングバッファ内の配置順に並べ、チャンクに分けて複数のスレッドで書き込む (フラッシュはチャンクごと)
+        std::vector<FillWorkerPool::Region> regions;
+        regions.reserve(bufferCopies.size() + imageCopies.size());
+        for (const BufferCopy& copy : bufferCopies) {
+            if (copy.fill) {
+                FillWorkerPool::Region region;
+                region.stagingOffset = copy.stagingOffset;
+                region.size = copy.size;
+                region.elementSize = copy.elementSize;
+                region.fill = copy.fill;
+                regions.push_back(std::move(region));
+            } else {
+                regions.push_back(FillWorkerPool::copyRegion(copy.stagingOffset, copy.data, copy.size));
+            }
+        }
+        for (const ImageCopy& copy : imageCopies) {
+            regions.push_back(FillWorkerPool::copyRegion(copy.stagingOffset, copy.data, copy.size));
+        }
+        std::sort(regions.begin(), regions.end(), [](const FillWorkerPool::Region& a, const FillWorkerPool::Region& b) {
+            return a.stagingOffset < b.stagingOffset;
+        });
+        fillWorkers->fill(stagingBuf, regions);
+        return stagingBuf;
+    }
+
+    // 呼び出し元のスレッドで書き込み、まとめてフラッシュする
+    char* stagingData = static_cast<char*>(stagingBuf.mapped());
+    for (const BufferCopy& copy : bufferCopies) {
+        if (copy.fill) {
+            copy.fill(stagingData + copy.stagingOffset, 0, copy.size);
+        } else {
+            copyToMapped(stagingData + copy.stagingOffset, copy.data, copy.size);
+        }
+    }
+    for (const ImageCopy& copy : imageCopies) {
+        copyToMapped(stagingData + copy.stagingOffset, copy.data, copy.size);
+    }
+    stagingBuf.flush(0, stagingSize);
+    return stagingBuf;
+}
+
+void UploadContext::recordCopies(vk::CommandBuffer cmdBuf, vk::Buffer stagingBuf) {
+    // 同じバッファへのコピーは1回の copyBuffer() にまとめる (予約はたいていバッファごとに連続している)
+    for (size_t i = 0; i < bufferCopies.size();) {
+        std::vector<vk::BufferCopy> regions;
+        size_t j = i;
+        for (; j < bufferCopies.size() && bufferCopies[j].dst == bufferCopies[i].dst; j++) {
+            vk::BufferCopy region;
+            region.srcOffset = bufferCopies[j].stagingOffset;
+            region.dstOffset = bufferCopies[j].dstOffset;
+            region.size = bufferCopies[j].size;
+            regions.push_back(region);
+        }
+        cmdBuf.copyBuffer(stagingBuf, bufferCopies[i].dst, regions);
+        i = j;
+    }
+
+    if (imageCopies.empty()) {
+        return;
+    }
+
+    // 全画像のコピー先へのレイアウト遷移を1回のバリアにまとめる
+    std::vector<vk::ImageMemoryBarrier> toTransfer(imageCopies.size());
+    for (size_t i = 0; i < imageCopies.size(); i++) {
+        toTransfer[i].srcAccessMask = {};
+        toTransfer[i].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+        toTransfer[i].oldLayout = vk::ImageLayout::eUndefined;
+        toTransfer[i].newLayout = vk::ImageLayout::eTransferDstOptimal;
+        toTransfer[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer[i].image = imageCopies[i].dst;
+        toTransfer[i].subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    }
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, toTransfer);
+
+    for (const ImageCopy& copy : imageCopies) {
+        vk::BufferImageCopy region;
+        region.bufferOffset = copy.stagingOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = vk::Offset3D(0, 0, 0);
+        region.imageExtent = copy.extent;
+        cmdBuf.copyBufferToImage(stagingBuf, copy.dst, vk::ImageLayout::eTransferDstOptimal, {region});
+    }
+}
+
+void UploadContext::recordBarriers(vk::CommandBuffer cmdBuf, Ownership ownership) {
+    // 解放側は転送の書き込みを完了させ、獲得側(または同じキュー)は後続のすべての読み出しから見えるようにする
+    vk::AccessFlags srcAccess = ownership == Ownership::Acquire ? vk::AccessFlags() : vk::AccessFlagBits::eTransferWrite;
+    vk::AccessFlags dstAccess = ownership == Ownership::Release ? vk::AccessFlags() : vk::AccessFlagBits::eMemoryRead;
+    vk::PipelineStageFlags srcStage = ownership == Ownership::Acquire ? vk::PipelineStageFlagBits::eTopOfPipe : vk::PipelineStageFlagBits::eTransfer;
+    vk::PipelineStageFlags dstStage = ownership == Ownership::Release ? vk::PipelineStageFlagBits::eBottomOfPipe : vk::PipelineStageFlagBits::eAllCommands;
+    uint32_t srcFamily = ownership == Ownership::None ? VK_QUEUE_FAMILY_IGNORED : transferQueueFamilyIndex;
+    uint32_t dstFamily = ownership == Ownership::None ? VK_QUEUE_FAMILY_IGNORED : dstQueueFamilyIndex;
+
+    std::vector<vk::MemoryBarrier> memoryBarriers;
+    std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+    if (ownership == Ownership::None) {
+        // 同じキューファミリーならバッファはまとめて1つのメモリバリアでよい
+        if (!bufferCopies.empty()) {
+            vk::MemoryBarrier memoryBarrier;
+            memoryBarrier.srcAccessMask = srcAccess;
+            memoryBarrier.dstAccessMask = dstAccess;
+            memoryBarriers.push_back(memoryBarrier);
+        }
+    } else {
+        // 所有権の移動はリソースごとに解放側と獲得側で同じ範囲を指定する
+        for (const BufferCopy& copy : bufferCopies) {
+            vk::BufferMemoryBarrier bufferBarrier;
+            bufferBarrier.srcAccessMask = srcAccess;
+            bufferBarrier.dstAccessMask = dstAccess;
+            bufferBarrier.srcQueueFamilyIndex = srcFamily;
+            bufferBarrier.dstQueueFamilyIndex = dstFamily;
+            bufferBarrier.buffer = copy.dst;
+            bufferBarrier.offset = copy.dstOffset;
+            bufferBarrier.size = copy.size;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    std::vector<vk::ImageMemoryBarrier> imageBarriers(imageCopies.size());
+    for (size_t i = 0; i < imageCopies.size(); i++) {
+        imageBarriers[i].srcAccessMask = srcAccess;
+        imageBarriers[i].dstAccessMask = dstAccess;
+        imageBarriers[i].oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        imageBarriers[i].newLayout = imageCopies[i].finalLayout;
+        imageBarriers[i].srcQueueFamilyIndex = srcFamily;
+        imageBarriers[i].dstQueueFamilyIndex = dstFamily;
+        imageBarriers[i].image = imageCopies[i].dst;
+        imageBarriers[i].subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    }
+
+    cmdBuf.pipelineBarrier(srcStage, dstStage, {}, memoryBarriers, bufferBarriers, imageBarriers);
+}
+
+void UploadContext::clear() {
+    bufferCopies.clear();
+    imageCopies.clear();
+    stagingSize = 0;
+}
+
+UploadFuture UploadContext::submit(FrameScheduler& scheduler, vk::Queue queue) {
+    writeDirect();
+    if (bufferCopies.empty() && imageCopies.empty()) {
+        return UploadFuture();
+    }
+
+    PooledBuffer stagingBuf = fillStaging();
+
+    size_t cmdBufIndex = acquireCommandBuffer(transferCommands, scheduler);
+    vk::CommandBuffer cmdBuf = transferCommands.buffers[cmdBufIndex].get();
+
+    vk::CommandBufferBeginInfo cmdBeginInfo;
+    cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    cmdBuf.begin(cmdBeginInfo);
+    recordCopies(cmdBuf, stagingBuf.buffer());
+    recordBarriers(cmdBuf, Ownership::None);
+    cmdBuf.end();
+
+    vk::CommandBuffer submitCmdBuf[1] = {cmdBuf};
+    vk::SubmitInfo submitInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = submitCmdBuf;
+
+    uint64_t value = scheduler.submit(queue, submitInfo);
+    transferCommands.values[cmdBufIndex] = value;
+    bufferPool.recycleAfter(scheduler, value, std::move(stagingBuf));
+
+    clear();
+    return UploadFuture(&scheduler, value);
+}
+
+UploadFuture UploadContext::submitWithHandoff(FrameScheduler& transferScheduler, vk::Queue transferQueue, FrameScheduler& dstScheduler, vk::Queue dstQueue) {
+    if (!transfersOwnership()) {
+        return submit(dstScheduler, dstQueue);
+    }
+    writeDirect();
+    if (bufferCopies.empty() && imageCopies.empty()) {
+        return UploadFuture();
+    }
+
+    PooledBuffer stagingBuf = fillStaging();
+
+    vk::CommandBufferBeginInfo cmdBeginInfo;
+    cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    // 転送キュー: コピーして所有権を解放する
+    size_t transferIndex = acquireCommandBuffer(transferCommands, transferScheduler);
+    vk::CommandBuffer transferCmdBuf = transferCommands.buffers[transferIndex].get();
+    transferCmdBuf.begin(cmdBeginInfo);
+    recordCopies(transferCmdBuf, stagingBuf.buffer());
+    recordBarriers(transferCmdBuf, Ownership::Release);
+    transferCmdBuf.end();
+
+    vk::CommandBuffer transferSubmitCmdBuf[1] = {transferCmdBuf};
+    vk::SubmitInfo transferSubmitInfo;
+    transferSubmitInfo.commandBufferCount = 1;
+    transferSubmitInfo.pCommandBuffers = transferSubmitCmdBuf;
+
+    uint64_t transferValue = transferScheduler.submit(transferQueue, transferSubmitInfo);
+    transferCommands.values[transferIndex] = transferValue;
+    bufferPool.recycleAfter(transferScheduler, transferValue, std::move(stagingBuf));
+
+    // 使う側のキュー: 転送の完了をタイムラインセマフォで待ってから所有権を獲得する
+    size_t acquireIndex = acquireCommandBuffer(acquireCommands, dstScheduler);
+    vk::CommandBuffer acquireCmdBuf = acquireCommands.buffers[acquireIndex].get();
+    acquireCmdBuf.begin(cmdBeginInfo);
+    recordBarriers(acquireCmdBuf, Ownership::Acquire);
+    acquireCmdBuf.end();
+
+    vk::CommandBuffer acquireSubmitCmdBuf[1] = {acquireCmdBuf};
+    vk::SubmitInfo acquireSubmitInfo;
+    acquireSubmitInfo.commandBufferCount = 1;
+    acquireSubmitInfo.pCommandBuffers = acquireSubmitCmdBuf;
+
+    FrameScheduler::TimelineWait transferWait;
+    transferWait.semaphore = transferScheduler.semaphore();
+    transferWait.value = transferValue;
+    transferWait.stage = vk::PipelineStageFlagBits::eAllCommands;
+
+    uint64_t value = dstScheduler.submit(dstQueue, acquireSubmitInfo, {transferWait});
+    acquireCommands.values[acquireIndex] = value;
+
+    clear();
+    return UploadFuture(&dstScheduler, value);
+}
+
+void UploadContext::report(std::ostream& os) const {
+    os << "upload context: staged " << counters.stagedUploads << " (" << counters.stagedBytes / 1024 << " KiB)"
+       << ", direct " << counters.directUploads << " (" << counters.directBytes / 1024 << " KiB)" << std::endl;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include "fill_worker_pool.h"
+#include "frame_scheduler.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// 投入したアップロードの完了を表すハンドル (タイムライン値)
+//  CPUからポーリングや待機ができるほか、asWait() で描画の投入をGPU上で完了に依存させられる
+class UploadFuture {
+public:
+    UploadFuture() = default;
+    UploadFuture(const FrameScheduler* scheduler, uint64_t value) : scheduler(scheduler), timelineValue(value) {}
+
+    // アップロードを投入したか (予約がなく何も投入しなかった場合はfalse)
+    bool valid() const { return scheduler != nullptr && timelineValue != 0; }
+
+    // 完了したか (投入していなければ完了とみなす)
+    bool isReady() const { return !valid() || scheduler->completedValue() >= timelineValue; }
+
+    // 完了するまでCPUで待つ。グラフィックスキューの他の処理は待たない
+    void wait() const {
+        if (valid()) {
+            scheduler->wait(timelineValue);
+        }
+    }
+
+    // 投入時に完了を待つための待機情報 (stage より前の処理は待たずに進められる)
+    FrameScheduler::TimelineWait asWait(vk::PipelineStageFlags stage) const {
+        FrameScheduler::TimelineWait timelineWait;
+        timelineWait.semaphore = scheduler->semaphore();
+        timelineWait.value = timelineValue;
+        timelineWait.stage = stage;
+        return timelineWait;
+    }
+
+    uint64_t value() const { return timelineValue; }
+
+private:
+    const FrameScheduler* scheduler = nullptr;
+    uint64_t timelineValue = 0;
+};
+
+// 複数のバッファ・画像へのアップロードをまとめて、1つのステージングバッファと1つのコマンドバッファで1回だけ投入するコンテキスト
+//  リソースごとにコマンドバッファを記録して投入・完了待ちを繰り返すと、起動時にGPUとの往復がリソース数だけ発生する。
+//  uploadBuffer()/uploadImage() はコピーを予約するだけで、submit() でデータをステージングバッファへ詰めて投入する。
+//  転送専用のキューファミリーがあれば、コピーをそこで実行してグラフィックスキューの描画と並行させられる。
+//  その場合は転送キューでの所有権の解放と、使う側のキューでの獲得をタイムラインセマフォで順序付ける。
+//  コピー先のメモリがホストから書き込める場合 (統合GPUやCPU実装のドライバのUMA) は、ステージングを経由せずに直接書き込む。
+//  コマンドバッファはこのコンテキストのプールから確保するため、投入した処理の完了後に破棄すること。
+class UploadContext {
+public:
+    struct Stats {
+        uint64_t stagedUploads = 0;   // ステージングバッファからコピーした数
+        uint64_t stagedBytes = 0;
+        uint64_t directUploads = 0;   // コピー先のメモリへ直接書き込んだ数
+        uint64_t directBytes = 0;
+    };
+
+    // queueFamilyIndex のキューでコピーし、同じキューで使う
+    UploadContext(BufferPool& bufferPool, vk::Device device, uint32_t queueFamilyIndex);
+
+    // transferQueueFamilyIndex のキューでコピーし、dstQueueFamilyIndex のキューで使う (異なる場合は所有権を移す)
+    UploadContext(BufferPool& bufferPool, vk::Device device, uint32_t transferQueueFamilyIndex, uint32_t dstQueueFamilyIndex);
+
+    // グラフィックスもコンピュートも持たない転送専用のキューファミリーを探す (なければUINT32_MAX)
+    //  CPU実装のドライバなどキューファミリーが1つしかないデバイスでは見つからない
+    static uint32_t findTransferQueueFamily(vk::PhysicalDevice physicalDevice);
+
+    UploadContext(const UploadContext&) = delete;
+    UploadContext& operator=(const UploadContext&) = delete;
+
+    // data の size バイトを dst の dstOffset へコピーする予約をする
+    //  data は submit() まで有効であること
+    void uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size);
+
+    // dstMemory がホストから書き込めるメモリ (マップ済み) なら submit() で直接書き込み、そうでなければステージングからコピーする
+    //  直接書き込む場合はGPUの処理と順序付けられないため、dst がGPUで使用中でないこと。dstMemory は submit() まで有効であること
+    void uploadBuffer(vk::Buffer dst, const DeviceAllocation& dstMemory, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size);
+
+    // fill で生成・変換した size バイトを dst の dstOffset へコピーする予約をする
+    //  fill は submit() の中で、ステージングバッファの書き込み先と範囲を指定して呼ばれる
+    //  setFillWorkers() を指定した場合は elementSize の倍数の範囲に分けて複数のスレッドから同時に呼ばれる
+    void uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize elementSize, FillWorkerPool::FillFunc fill);
+
+    // data を画像 dst のミップレベル0・レイヤー0 (カラー) へコピーする予約をする
+    //  画像のレイアウトは eUndefined から eTransferDstOptimal を経て finalLayout に遷移する
+    //  data は submit() まで有効であること
+    void uploadImage(vk::Image dst, vk::Extent3D extent, const void* data, vk::DeviceSize size,
+                     vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    // 予約したコピーをまとめて queue へ投入し、完了を表すハンドルを返す (コピーがなければ無効なハンドル)
+    //  直接書き込むアップロードはここで書き込み、フラッシュする
+    //  ステージングバッファは完了後の scheduler.retire() でバッファプールへ戻る。コピーと使う側のキューファミリーが同じ場合に使う
+    UploadFuture submit(FrameScheduler& scheduler, vk::Queue queue);
+
+    // 予約したコピーを transferQueue へ投入して所有権を解放し、transferScheduler の完了を待って
+    // dstQueue で所有権を獲得する処理を投入する。CPUは待たない。戻り値は dstScheduler での完了を表す
+    //  キューファミリーが同じ場合は dstQueue に submit() するだけになる
+    UploadFuture submitWithHandoff(FrameScheduler& transferScheduler, vk::Queue transferQueue, FrameScheduler& dstScheduler, vk::Queue dstQueue);
+
+    // submit() でのステージングバッファへの書き込みを fillWorkers のスレッドで分担する (nullptrなら呼び出し元のスレッドだけで書き込む)
+    //  fillWorkers はこのコンテキストより長く生存させること
+    void setFillWorkers(FillWorkerPool* fillWorkers) { this->fillWorkers = fillWorkers; }
+
+    bool transfersOwnership() const { return transferQueueFamilyIndex != dstQueueFamilyIndex; }
+
+    size_t pendingCount() const { return bufferCopies.size() + imageCopies.size() + directWrites.size(); }
+    vk::DeviceSize pendingBytes() const { return stagingSize; }
+
+    // これまでにステージング経由と直接書き込みのそれぞれでアップロードした数
+    Stats stats() const { return counters; }
+    void report(std::ostream& os) const;
+
+private:
+    struct BufferCopy {
+        vk::Buffer dst;
+        vk::DeviceSize dstOffset;
+        const void* data;   // fill を指定した場合はnullptr
+        vk::DeviceSize size;
+        vk::DeviceSize stagingOffset;
+        vk::DeviceSize elementSize;
+        FillWorkerPool::FillFunc fill;
+    };
+
+    // ステージングを経由せずにコピー先のメモリへ書き込むアップロード
+    struct DirectWrite {
+        const DeviceAllocation* memory;
+        vk::DeviceSize dstOffset;
+        const void* data;
+        vk::DeviceSize size;
+    };
+
+    struct ImageCopy {
+        vk::Image dst;
+        vk::Extent3D extent;
+        const void* data;
+        vk::DeviceSize size;
+        vk::DeviceSize stagingOffset;
+        vk::ImageLayout finalLayout;
+    };
+
+    // キューファミリーごとのコマンドプールと、再利用するコマンドバッファ
+    struct CommandBuffers {
+        vk::UniqueCommandPool pool;
+        std::vector<vk::UniqueCommandBuffer> buffers;
+        std::vector<uint64_t> values;  // コマンドバッファごとの最後の投入のタイムライン値
+    };
+
+    // 所有権を移す場合のバリアの向き
+    enum class Ownership { None, Release, Acquire };
+
+    void createCommandPool(CommandBuffers& commandBuffers, uint32_t queueFamilyIndex);
+    // 前回の投入が完了したコマンドバッファを再利用し、なければ新しく確保する。戻り値は buffers のインデックス
+    size_t acquireCommandBuffer(CommandBuffers& commandBuffers, const FrameScheduler& scheduler);
+    vk::DeviceSize reserveStaging(vk::DeviceSize size);
+    void writeDirect();
+    PooledBuffer fillStaging();
+    void recordCopies(vk::CommandBuffer cmdBuf, vk::Buffer stagingBuf);
+    void recordBarriers(vk::CommandBuffer cmdBuf, Ownership ownership);
+    void clear();
+
+    BufferPool& bufferPool;
+    FillWorkerPool* fillWorkers;
+    vk::Device device;
+    uint32_t transferQueueFamilyIndex;
+    uint32_t dstQueueFamilyIndex;
+    CommandBuffers transferCommands;
+    CommandBuffers acquireCommands;  // 所有権を移す場合のみ使う
+
+    std::vector<BufferCopy> bufferCopies;
+    std::vector<ImageCopy> imageCopies;
+    std::vector<DirectWrite> directWrites;
+    vk::DeviceSize stagingSize;
+    Stats counters;
+};
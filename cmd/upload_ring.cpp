@@ -0,0 +1,67 @@
+#include "upload_ring.h"
+#include "memory_type.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+UploadRing::UploadRing(DeviceAllocator& allocator, uint32_t regionCount, vk::DeviceSize regionSize, vk::BufferUsageFlags usage)
+    : regionSize(regionSize),
+      regionCount(regionCount),
+      regionBegin(0),
+      head(0),
+      flushedHead(0),
+      peakUsage(0),
+      overflowCount(0) {
+    vk::Device device = allocator.getDevice();
+
+    vk::BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.size = regionSize * regionCount;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    buffer = device.createBufferUnique(bufferCreateInfo);
+
+    vk::MemoryRequirements memReq = device.getBufferMemoryRequirements(buffer.get());
+    uint32_t memTypeIndex = selectMemoryType(allocator.memoryProperties(), memReq.memoryTypeBits, MemoryUsage::Dynamic);
+    if (memTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("アップロードリングに使えるメモリタイプが存在しません。");
+    }
+    memory = allocator.allocateForBuffer(buffer.get(), memTypeIndex, MemoryUsage::Dynamic);
+}
+
+void UploadRing::beginFrame(uint32_t slotIndex) {
+    regionBegin = regionSize * (slotIndex % regionCount);
+    head = 0;
+    flushedHead = 0;
+}
+
+UploadRing::Span UploadRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    vk::DeviceSize offset = (head + alignment - 1) / alignment * alignment;
+
+    Span span;
+    span.buffer = buffer.get();
+    if (offset + size > regionSize) {
+        overflowCount++;
+        return span;
+    }
+
+    head = offset + size;
+    peakUsage = std::max(peakUsage, head);
+
+    span.offset = regionBegin + offset;
+    span.size = size;
+    span.data = static_cast<char*>(memory.mapped()) + regionBegin + offset;
+    return span;
+}
+
+void UploadRing::flush() {
+    if (head > flushedHead) {
+        memory.flush(regionBegin + flushedHead, head - flushedHead);
+        flushedHead = head;
+    }
+}
+
+void UploadRing::report(std::ostream& os) const {
+    os << "upload ring: " << regionCount << " x " << regionSize << " bytes"
+       << ", peak usage per frame: " << peakUsage << " bytes"
+       << ", overflows: " << overflowCount << std::endl;
+}
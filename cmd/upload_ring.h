@@ -0,0 +1,56 @@
+#pragma once
+
+#include "device_allocator.h"
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <ostream>
+
+// 永続マップしたバッファをフレームスロットごとの領域に分け、毎フレームの書き込みを切り出すリングバッファ
+//  領域内はポインタを進めるだけで割り当てるため、毎フレームのアップロードでドライバを呼ばない。
+//  領域はスロットの前回の投入分が完了した時 (FrameRing::acquire() の後) に再利用する。
+class UploadRing {
+public:
+    // 切り出した領域
+    struct Span {
+        vk::Buffer buffer;
+        vk::DeviceSize offset = 0;   // buffer 内のオフセット (バインドやコピー元に使う)
+        vk::DeviceSize size = 0;
+        void* data = nullptr;        // 書き込み先 (領域が足りない場合はnullptr)
+    };
+
+    // regionSize のバイト数の領域を regionCount 個持つバッファを作成する
+    //  メモリはGPUが直接読むため MemoryUsage::Dynamic で選ぶ (デバイスローカルかつホスト可視のメモリを優先する)
+    UploadRing(DeviceAllocator& allocator, uint32_t regionCount, vk::DeviceSize regionSize, vk::BufferUsageFlags usage);
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // スロット slotIndex の領域を先頭から使い始める
+    //  スロットの前回の投入分がGPUで完了していることは呼び出し側が保証する
+    void beginFrame(uint32_t slotIndex);
+
+    // 現在の領域から size バイトを alignment に揃えて切り出す
+    Span allocate(vk::DeviceSize size, vk::DeviceSize alignment = 4);
+
+    // 現在の領域に書き込んだ範囲をデバイスへ反映させる (HostCoherentのメモリでは何もしない)
+    void flush();
+
+    vk::Buffer getBuffer() const { return buffer.get(); }
+
+    // フレームあたりの最大使用量と、領域が足りず切り出せなかった回数を出力する
+    void report(std::ostream& os) const;
+
+private:
+    vk::UniqueBuffer buffer;
+    DeviceAllocation memory;
+    vk::DeviceSize regionSize;
+    uint32_t regionCount;
+
+    vk::DeviceSize regionBegin;
+    vk::DeviceSize head;          // 現在の領域で次に割り当てる位置 (領域の先頭からのオフセット)
+    vk::DeviceSize flushedHead;   // flush() 済みの位置
+
+    vk::DeviceSize peakUsage;
+    uint64_t overflowCount;
+};
@@ -4,6 +4,18 @@
 #include "input_data.h"
 #include "index_buffer.h"
 #include "staging_buffer.h"
+#include "allocator_bench.h"
+#include "memory_bandwidth_bench.h"
+#include "buddy_soak_bench.h"
+#include "buffer_pool_bench.h"
+#include "upload_batch_bench.h"
+#include "streaming_bench.h"
+#include "geometry_arena_bench.h"
+#include "staging_fill_bench.h"
+#include "mapped_copy_bench.h"
+#include "sample_options.h"
+#include "bench_options.h"
+#include "present_mode.h"
 #include <cxxopts.hpp>
 #include <iostream>
 #include <memory>
@@ -13,6 +25,20 @@ int main(int argc, char** argv) {
 
     options.add_options()
         ("s,sample", "実行するサンプル番号を指定する", cxxopts::value<int>()->default_value("5"))
+        ("f,frames-in-flight", "同時に処理中にできるフレーム数 (サンプル2〜5)", cxxopts::value<uint32_t>()->default_value("2"))
+        ("p,present-mode", "プレゼンテーションモード (fifo, mailbox, immediate, auto=ティアリングなしで低レイテンシなmailbox→fifo)", cxxopts::value<std::string>()->default_value("auto"))
+        ("headless", "ウインドウを作らずヘッドレスサーフェースに描画する (サンプル2〜5)")
+        ("n,frames", "描画するフレーム数 (0なら無制限、ヘッドレスモードでは既定で1000)", cxxopts::value<uint64_t>()->default_value("0"))
+        ("resize-churn", "指定フレームごとに表示サイズを変えてスワップチェーンを作り直す (サンプル2〜5)", cxxopts::value<uint32_t>()->default_value("0"))
+        ("static-scene", "描画コマンドを事前に記録し、毎フレームは投入のみ行う (サンプル5)")
+        ("record-threads", "描画コマンドをセカンダリコマンドバッファに並列記録するスレッド数。0ならメインスレッドで記録する (サンプル5)", cxxopts::value<uint32_t>()->default_value("0"))
+        ("draws", "1フレームあたりの描画コマンド数 (サンプル5)", cxxopts::value<uint32_t>()->default_value("1"))
+        ("gpu-timestamps", "タイムスタンプクエリでレンダーパスと描画ごとのGPU時間を計測する (サンプル2〜5)")
+        ("stats", "パイプライン統計クエリで描画ごとの頂点数、プリミティブ数、シェーダー実行回数などを計測する (サンプル2〜5)")
+        ("dynamic-geometry", "毎フレーム頂点データを書き換え、フレームごとのアップロードリングから描画する (サンプル5)")
+        ("dedicated-threshold", "指定KiBを超えるリソースに専用のデバイスメモリを確保する。0ならブロックサイズの半分 (サンプル1, 5)", cxxopts::value<uint64_t>()->default_value("0"))
+        ("b,bench", "サンプルの代わりに指定したベンチマークを実行する (allocator, memory-types, buddy-soak, buffer-pool, upload-batch, streaming, geometry-arena, staging-fill, mapped-copy)", cxxopts::value<std::string>())
+        ("bench-count", "ベンチマークで処理するリソース数・反復回数 (0ならベンチマークごとの既定値)", cxxopts::value<uint32_t>()->default_value("0"))
         ("h,help", "利用方法")
     ;
 
@@ -32,12 +58,62 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (parseResult.count("bench")) {
+        BenchOptions benchOptions;
+        benchOptions.count = parseResult["bench-count"].as<uint32_t>();
+
+        std::map<std::string, std::function<std::unique_ptr<Command>()>> benchRegistry = {
+            {"allocator", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new AllocatorBench(benchOptions)); }},
+            {"memory-types", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new MemoryBandwidthBench(benchOptions)); }},
+            {"buddy-soak", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new BuddySoakBench(benchOptions)); }},
+            {"buffer-pool", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new BufferPoolBench(benchOptions)); }},
+            {"upload-batch", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new UploadBatchBench(benchOptions)); }},
+            {"streaming", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new StreamingBench(benchOptions)); }},
+            {"geometry-arena", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new GeometryArenaBench(benchOptions)); }},
+            {"staging-fill", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new StagingFillBench(benchOptions)); }},
+            {"mapped-copy", [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new MappedCopyBench(benchOptions)); }},
+        };
+        // ベンチマーク名から実行するコマンドクラスのインスタンスを取得
+        auto bench = benchRegistry.find(parseResult["bench"].as<std::string>());
+        if (bench == benchRegistry.end()) {
+            std::cerr << "不明なベンチマーク名が指定されました" << std::endl;
+            return 1;
+        }
+        return bench->second()->execute();
+    }
+
+    // スワップチェーンを使うサンプルに渡すオプション
+    SampleOptions sampleOptions;
+    sampleOptions.framesInFlight = parseResult["frames-in-flight"].as<uint32_t>();
+    if (sampleOptions.framesInFlight == 0) {
+        std::cerr << "フレーム数には1以上を指定してください" << std::endl;
+        return 1;
+    }
+    if (!parsePresentModePolicy(parseResult["present-mode"].as<std::string>(), sampleOptions.presentModePolicy)) {
+        std::cerr << "不明なプレゼンテーションモードが指定されました" << std::endl;
+        return 1;
+    }
+    sampleOptions.headless = parseResult.count("headless") > 0;
+    sampleOptions.frameCount = parseResult["frames"].as<uint64_t>();
+    sampleOptions.resizeChurnInterval = parseResult["resize-churn"].as<uint32_t>();
+    sampleOptions.staticScene = parseResult.count("static-scene") > 0;
+    sampleOptions.recordThreads = parseResult["record-threads"].as<uint32_t>();
+    sampleOptions.drawCount = parseResult["draws"].as<uint32_t>();
+    sampleOptions.gpuTimestamps = parseResult.count("gpu-timestamps") > 0;
+    sampleOptions.pipelineStats = parseResult.count("stats") > 0;
+    sampleOptions.dynamicGeometry = parseResult.count("dynamic-geometry") > 0;
+    sampleOptions.dedicatedThreshold = parseResult["dedicated-threshold"].as<uint64_t>() * 1024;
+    if (sampleOptions.headless && sampleOptions.frameCount == 0) {
+        // ヘッドレスモードではウインドウを閉じて終了できないため固定フレーム数だけ描画する
+        sampleOptions.frameCount = 1000;
+    }
+
     std::map<int, std::function<std::unique_ptr<Command>()>> classRegistry = {
-        {1, []() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new SimpleTriangle()); }},
-        {2, []() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new SampleGLFW()); }},
-        {3, []() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new InputData()); }},
-        {4, []() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new IndexBuffer()); }},
-        {5, []() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new StagingBuffer()); }},
+        {1, [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new SimpleTriangle(sampleOptions)); }},
+        {2, [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new SampleGLFW(sampleOptions)); }},
+        {3, [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new InputData(sampleOptions)); }},
+        {4, [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new IndexBuffer(sampleOptions)); }},
+        {5, [&]() -> std::unique_ptr<Command> { return std::unique_ptr<Command>(new StagingBuffer(sampleOptions)); }},
     };
     // サンプル番号から実行するコマンドクラスのインスタンスを取得
     auto res = classRegistry.find(parseResult["sample"].as<int>());